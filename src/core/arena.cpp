@@ -0,0 +1,147 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "arena.hpp"
+
+#include <algorithm>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "config.hpp"
+
+// region helpers
+
+static size_t round_up(size_t size, size_t multiple) {
+	return (size + multiple - 1) / multiple * multiple;
+}
+
+// Size of the blocks served for the request, small requests come from the regular heap
+static size_t block_size(size_t size) {
+	if (size < ARENA_MIN_BYTES) {
+		return round_up(size, ARENA_ALIGNMENT);
+	}
+
+	return round_up(size, size >= ARENA_HUGE_PAGE ? ARENA_HUGE_PAGE : sysconf(_SC_PAGESIZE));
+}
+
+// region buffer_arena
+
+buffer_arena::~buffer_arena() {
+	trim();
+}
+
+buffer_arena& buffer_arena::shared() {
+
+	// never destroyed, so buffers released by other static objects at exit still have somewhere to go
+	static buffer_arena* arena = new buffer_arena();
+	return *arena;
+}
+
+void buffer_arena::use_hugetlb(bool enabled) {
+	std::lock_guard lock{m_mutex};
+	m_hugetlb = enabled;
+}
+
+void* buffer_arena::map(size_t size) const {
+
+	// reserved huge pages are only there if the system was configured with some
+	if (m_hugetlb && size % ARENA_HUGE_PAGE == 0) {
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (data != MAP_FAILED) {
+			return data;
+		}
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (data == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+
+	// frames are scanned linearly, so fewer TLB entries per megabyte help, the hint is ignored without THP
+	if (size >= ARENA_HUGE_PAGE) {
+		madvise(data, size, MADV_HUGEPAGE);
+	}
+
+	return data;
+}
+
+void* buffer_arena::acquire(size_t size) {
+	const size_t needed = block_size(size);
+
+	if (needed < ARENA_MIN_BYTES) {
+		return ::operator new(needed, std::align_val_t(ARENA_ALIGNMENT));
+	}
+
+	std::unique_lock lock{m_mutex};
+
+	// the smallest kept block that fits, as long as it doesn't waste more than it holds
+	auto best = m_free.end();
+
+	for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+		if (it->size >= needed && it->size <= needed * 2 && (best == m_free.end() || it->size < best->size)) {
+			best = it;
+		}
+	}
+
+	if (best != m_free.end()) {
+		void* data = best->data;
+		m_kept -= best->size;
+		m_free.erase(best);
+		return data;
+	}
+
+	lock.unlock();
+	return map(needed);
+}
+
+void buffer_arena::release(void* data, size_t size) {
+	const size_t held = block_size(size);
+
+	if (held < ARENA_MIN_BYTES) {
+		::operator delete(data, std::align_val_t(ARENA_ALIGNMENT));
+		return;
+	}
+
+	std::lock_guard lock{m_mutex};
+
+	// forget the oldest buffers first, the newest ones are the most likely to be needed again
+	m_free.push_back({data, held});
+	m_kept += held;
+
+	while (m_kept > ARENA_KEPT_BYTES && !m_free.empty()) {
+		munmap(m_free.front().data, m_free.front().size);
+		m_kept -= m_free.front().size;
+		m_free.erase(m_free.begin());
+	}
+}
+
+void buffer_arena::trim() {
+	std::lock_guard lock{m_mutex};
+
+	for (const block& entry : m_free) {
+		munmap(entry.data, entry.size);
+	}
+
+	m_free.clear();
+	m_kept = 0;
+}
+
+size_t buffer_arena::kept() const {
+	std::lock_guard lock{m_mutex};
+	return m_kept;
+}
@@ -0,0 +1,128 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Allocator of large buffers for frames and backbuffers, aligned for vector instructions and backed by
+// huge pages where possible, released buffers are kept for reuse, so that showing image after image
+// (e.g. in daemon mode) doesn't map and fault in the same amount of memory over and over again
+class buffer_arena {
+
+	struct block {
+		void* data;
+		size_t size;
+	};
+
+	mutable std::mutex m_mutex;
+	std::vector<block> m_free;
+	size_t m_kept = 0;
+	bool m_hugetlb = false;
+
+	// Map a new block of exactly the given size, which is a multiple of the page size
+	void* map(size_t size) const;
+
+public:
+
+	~buffer_arena();
+
+	// Arena shared by the whole process
+	static buffer_arena& shared();
+
+	// Also try explicitly reserved huge pages (MAP_HUGETLB) before transparent ones
+	void use_hugetlb(bool enabled);
+
+	// Get a buffer of at least the given size, aligned to ARENA_ALIGNMENT, its contents are undefined
+	void* acquire(size_t size);
+
+	// Give back a buffer from acquire() of the same size, for later reuse
+	void release(void* data, size_t size);
+
+	// Unmap all kept buffers
+	void trim();
+
+	// Total size of the kept buffers, in bytes
+	size_t kept() const;
+};
+
+// Array of trivial elements allocated from the shared arena and given back to it when destroyed
+template <typename T>
+class arena_buffer {
+
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	T* m_data = nullptr;
+	size_t m_count = 0;
+
+public:
+
+	arena_buffer() = default;
+
+	// Allocate the given number of uninitialized elements
+	explicit arena_buffer(size_t count)
+		: m_count(count) {
+
+		if (count) {
+			m_data = static_cast<T*>(buffer_arena::shared().acquire(count * sizeof(T)));
+		}
+	}
+
+	arena_buffer(arena_buffer&& other) noexcept
+		: m_data(std::exchange(other.m_data, nullptr)), m_count(std::exchange(other.m_count, 0)) {}
+
+	arena_buffer& operator=(arena_buffer&& other) noexcept {
+		std::swap(m_data, other.m_data);
+		std::swap(m_count, other.m_count);
+		return *this;
+	}
+
+	arena_buffer(const arena_buffer&) = delete;
+	arena_buffer& operator=(const arena_buffer&) = delete;
+
+	~arena_buffer() {
+		if (m_data) {
+			buffer_arena::shared().release(m_data, m_count * sizeof(T));
+		}
+	}
+
+	T* data() const {
+		return m_data;
+	}
+
+	T* get() const {
+		return m_data;
+	}
+
+	size_t size() const {
+		return m_count;
+	}
+
+	bool empty() const {
+		return m_count == 0;
+	}
+
+	explicit operator bool() const {
+		return m_data != nullptr;
+	}
+
+	T& operator[](size_t index) const {
+		return m_data[index];
+	}
+};
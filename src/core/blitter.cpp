@@ -0,0 +1,132 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "blitter.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "kernels.hpp"
+#include "simd.hpp"
+
+// region generic
+
+static YAV_FORCE_INLINE size_t generic_bytes(const format& fmt) {
+	return std::min(fmt.bytes(), 8UL);
+}
+
+static void generic_copy(const format& fmt, uint8_t* dst, const uint8_t* src, int count) {
+	const size_t bytes = generic_bytes(fmt);
+
+	// save a few cycles by encoding alpha only once
+	const size_t alpha = fmt.encode_alpha(0xff);
+
+	for (int i = 0; i < count; i++) {
+		const uint8_t* pixel = src + i * 4;
+		const size_t encoded = fmt.encode_rgb(pixel[0], pixel[1], pixel[2]) | alpha;
+		memcpy(dst + i * bytes, &encoded, bytes);
+	}
+}
+
+static void generic_blend(const format& fmt, uint8_t* dst, const uint8_t* src, const color* back, int count) {
+	const size_t bytes = generic_bytes(fmt);
+	const size_t alpha = fmt.encode_alpha(0xff);
+
+	for (int i = 0; i < count; i++) {
+		color front = color::from_rgba(src + i * 4);
+		blend_pixel(front, back[i]);
+
+		const size_t encoded = fmt.encode_rgb(front.r, front.g, front.b) | alpha;
+		memcpy(dst + i * bytes, &encoded, bytes);
+	}
+}
+
+static void generic_read(const format& fmt, color* dst, const uint8_t* src, int count) {
+	const size_t bytes = generic_bytes(fmt);
+
+	for (int i = 0; i < count; i++) {
+		size_t pixel = 0;
+		memcpy(&pixel, src + i * bytes, bytes);
+		fmt.decode_rgb(pixel, &dst[i].r, &dst[i].g, &dst[i].b);
+	}
+}
+
+static void generic_fill(const format& fmt, uint8_t* dst, color c, int count) {
+	const size_t bytes = generic_bytes(fmt);
+	const size_t alpha = fmt.encode_alpha(0xff);
+
+	if (c.a == 255) {
+		const size_t encoded = fmt.encode_rgb(c.r, c.g, c.b) | alpha;
+
+		for (int i = 0; i < count; i++) {
+			memcpy(dst + i * bytes, &encoded, bytes);
+		}
+
+		return;
+	}
+
+	for (int i = 0; i < count; i++) {
+		color back;
+		generic_read(fmt, &back, dst + i * bytes, 1);
+
+		color front = c;
+		blend_pixel(front, back);
+
+		const size_t encoded = fmt.encode_rgb(front.r, front.g, front.b) | alpha;
+		memcpy(dst + i * bytes, &encoded, bytes);
+	}
+}
+
+// region blitter
+
+struct registered {
+	format fmt;
+	blitter kernels;
+};
+
+template <typename Kernel>
+static registered make_entry(const char* name) {
+	registered entry{Kernel::layout(), {name, Kernel::copy, Kernel::blend, Kernel::read, Kernel::fill}};
+
+	// swap in vectorized kernels if the host CPU supports them
+	simd_accelerate(entry.fmt, entry.kernels);
+	return entry;
+}
+
+// Formats are named after their DRM fourcc counterparts, from the most significant bit
+static const registered registry[] = {
+	make_entry<fixed<32, 8, 16, 8, 8, 8, 0>>("XRGB8888"),
+	make_entry<fixed<32, 8, 16, 8, 8, 8, 0, 8, 24>>("ARGB8888"),
+	make_entry<fixed<32, 8, 0, 8, 8, 8, 16>>("XBGR8888"),
+	make_entry<fixed<32, 8, 0, 8, 8, 8, 16, 8, 24>>("ABGR8888"),
+	make_entry<fixed<24, 8, 16, 8, 8, 8, 0>>("RGB888"),
+	make_entry<fixed<24, 8, 0, 8, 8, 8, 16>>("BGR888"),
+	make_entry<fixed<16, 5, 11, 6, 5, 5, 0>>("RGB565"),
+	make_entry<fixed<16, 5, 0, 6, 5, 5, 11>>("BGR565"),
+};
+
+const blitter& blitter::pick(const format& fmt) {
+	for (const registered& entry : registry) {
+		if (entry.fmt == fmt) {
+			return entry.kernels;
+		}
+	}
+
+	return fallback();
+}
+
+const blitter& blitter::fallback() {
+	static const blitter generic{"generic", generic_copy, generic_blend, generic_read, generic_fill};
+	return generic;
+}
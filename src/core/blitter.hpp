@@ -0,0 +1,58 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include "color.hpp"
+#include "format.hpp"
+
+#ifdef __GNUC__
+#define YAV_FORCE_INLINE __attribute__((always_inline)) inline
+#else
+#define YAV_FORCE_INLINE inline
+#endif
+
+// Set of row kernels that convert between RGBA image data and a specific
+// screen pixel format, all rows are given as pointers to the first pixel
+struct blitter {
+
+	// Store `count` RGBA pixels in the destination format, alpha is discarded
+	using copy_row = void (*)(const format& fmt, uint8_t* dst, const uint8_t* src, int count);
+
+	// Blend `count` RGBA pixels over the background colors and store the result
+	using blend_row = void (*)(const format& fmt, uint8_t* dst, const uint8_t* src, const color* back, int count);
+
+	// Decode `count` pixels stored in the destination format
+	using read_row = void (*)(const format& fmt, color* dst, const uint8_t* src, int count);
+
+	// Fill `count` pixels with a color, blending it over the existing
+	// content when the color is not fully opaque
+	using fill_row = void (*)(const format& fmt, uint8_t* dst, color c, int count);
+
+	const char* name;
+
+	copy_row copy;
+	blend_row blend;
+	read_row read;
+	fill_row fill;
+
+	// Get the fastest kernels for the given format, falls back
+	// to the generic implementation for unknown layouts
+	static const blitter& pick(const format& fmt);
+
+	// Get the generic kernels, those work with any format
+	static const blitter& fallback();
+};
@@ -0,0 +1,220 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "config.hpp"
+
+// region frame_cache
+
+frame_cache::frame_cache(int width, int height, int frames, size_t bytes)
+	: m_width(std::max(width, 0)), m_height(std::max(height, 0)), m_frames(frames), m_pitch(m_width * bytes) {
+
+	m_buffer = arena_buffer<uint8_t>(m_pitch * m_height * m_frames);
+	m_ready.resize(m_frames, false);
+}
+
+bool frame_cache::is_ready(int frame) const {
+	return m_ready.at(frame);
+}
+
+void frame_cache::set_ready(int frame) {
+	m_ready.at(frame) = true;
+}
+
+uint8_t* frame_cache::data(int frame) {
+	if (frame >= m_frames) {
+		throw std::runtime_error("Cached frame out of range");
+	}
+
+	return m_buffer.data() + frame * m_pitch * m_height;
+}
+
+const uint8_t* frame_cache::data(int frame) const {
+	return const_cast<frame_cache*>(this)->data(frame);
+}
+
+int frame_cache::width() const {
+	return m_width;
+}
+
+int frame_cache::height() const {
+	return m_height;
+}
+
+size_t frame_cache::pitch() const {
+	return m_pitch;
+}
+
+int frame_cache::frame_count() const {
+	return m_frames;
+}
+
+// region delta_frames
+
+delta_frames::delta_frames(int width, int height, int frames, size_t bytes)
+	: m_width(std::max(width, 0)), m_height(std::max(height, 0)), m_bytes(bytes), m_pitch(m_width * bytes) {
+
+	m_deltas.resize(frames);
+	m_current = arena_buffer<uint8_t>(m_pitch * m_height);
+	m_previous = arena_buffer<uint8_t>(m_pitch * m_height);
+}
+
+delta_frames::delta delta_frames::encode(const uint8_t* frame, const uint8_t* previous, int width, int height, size_t bytes) {
+	const size_t pitch = width * bytes;
+	delta result;
+
+	const auto differs = [&](const uint8_t* row, const uint8_t* before, int x) {
+		return memcmp(row + x * bytes, before + x * bytes, bytes) != 0;
+	};
+
+	for (int y = 0; y < height; y++) {
+		const uint8_t* row = frame + y * pitch;
+		const uint8_t* before = previous + y * pitch;
+
+		if (memcmp(row, before, pitch) == 0) {
+			continue;
+		}
+
+		int x = 0;
+
+		while (x < width) {
+			while (x < width && !differs(row, before, x)) {
+				x++;
+			}
+
+			if (x == width) {
+				break;
+			}
+
+			// short stretches of unchanged pixels are cheaper to store than a new run
+			const int start = x;
+			int end = x;
+
+			for (x++; x < width && x - end <= CACHE_DELTA_GAP; x++) {
+				if (differs(row, before, x)) {
+					end = x;
+				}
+			}
+
+			const uint32_t length = end - start + 1;
+			result.runs.push_back({(uint32_t) y, (uint32_t) start, length});
+			result.pixels.insert(result.pixels.end(), row + start * bytes, row + (end + 1) * bytes);
+			result.changed = get_constraint_union({result.changed, {start, y, (int) length, 1}});
+			x = end + 1;
+		}
+	}
+
+	result.runs.shrink_to_fit();
+	result.pixels.shrink_to_fit();
+	result.ready = true;
+	return result;
+}
+
+bool delta_frames::is_ready(int frame) const {
+	return m_deltas.at(frame).ready;
+}
+
+uint8_t* delta_frames::scratch() {
+	return m_current.data();
+}
+
+constraint delta_frames::set_ready(int frame) {
+	const int last = frame_count() - 1;
+
+	if (frame != m_rendered || frame > last) {
+		throw std::runtime_error("Delta cached frames have to be rendered in order");
+	}
+
+	constraint changed{0, 0, m_width, m_height};
+
+	if (frame == 0 && last > 0) {
+		m_first = arena_buffer<uint8_t>(m_pitch * m_height);
+		memcpy(m_first.data(), m_current.data(), m_first.size());
+	} else if (frame == 0) {
+		m_deltas[0] = encode(m_current.data(), m_current.data(), m_width, m_height, m_bytes);
+	} else {
+		m_deltas[frame] = encode(m_current.data(), m_previous.data(), m_width, m_height, m_bytes);
+		changed = m_deltas[frame].changed;
+	}
+
+	// the loop wraps around from the last frame to the first
+	if (frame == last && last > 0) {
+		m_deltas[0] = encode(m_first.data(), m_current.data(), m_width, m_height, m_bytes);
+		m_first = {};
+	}
+
+	std::swap(m_current, m_previous);
+	m_rendered++;
+
+	// from now on frames are only ever replayed
+	if (frame == last) {
+		m_current = {};
+	}
+
+	return changed;
+}
+
+const uint8_t* delta_frames::latest() const {
+	return m_previous.data();
+}
+
+void delta_frames::release_latest() {
+	if (m_rendered < frame_count()) {
+		throw std::runtime_error("Delta cached frames are still being rendered");
+	}
+
+	m_previous = {};
+}
+
+constraint delta_frames::apply(int frame, uint8_t* dst, size_t stride) const {
+	const delta& entry = m_deltas.at(frame);
+
+	if (!entry.ready) {
+		throw std::runtime_error("Delta cached frame was not rendered yet");
+	}
+
+	const uint8_t* src = entry.pixels.data();
+
+	for (const pixel_run& run : entry.runs) {
+		const size_t length = run.length * m_bytes;
+
+		memcpy(dst + run.y * stride + run.x * m_bytes, src, length);
+		src += length;
+	}
+
+	return entry.changed;
+}
+
+size_t delta_frames::pitch() const {
+	return m_pitch;
+}
+
+int delta_frames::frame_count() const {
+	return (int) m_deltas.size();
+}
+
+size_t delta_frames::size() const {
+	size_t total = 0;
+
+	for (const delta& entry : m_deltas) {
+		total += entry.runs.size() * sizeof(pixel_run) + entry.pixels.size();
+	}
+
+	return total;
+}
@@ -0,0 +1,132 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arena.hpp"
+#include "viewport.hpp"
+
+// Frames of an image already converted into a screen format, stored
+// as tightly packed rows covering only the visible part of the image
+class frame_cache {
+
+	int m_width;
+	int m_height;
+	int m_frames;
+	size_t m_pitch;
+
+	arena_buffer<uint8_t> m_buffer;
+	std::vector<bool> m_ready;
+
+public:
+
+	frame_cache(int width, int height, int frames, size_t bytes);
+
+	// Check if the given frame was already rendered into the cache
+	bool is_ready(int frame) const;
+
+	// Mark the given frame as rendered
+	void set_ready(int frame);
+
+	// Get pointer to the first row of the given frame
+	uint8_t* data(int frame);
+	const uint8_t* data(int frame) const;
+
+	// Width, in pixels, of each frame
+	int width() const;
+
+	// Height, in pixels, of each frame
+	int height() const;
+
+	// Line length, in bytes, of each frame
+	size_t pitch() const;
+
+	// Number of frames this cache can hold
+	int frame_count() const;
+};
+
+// Frames of an image converted into a screen format, each stored only as the runs of pixels
+// that differ from the frame before it (the first one from the last), frames have to
+// be rendered in order, and are then replayed by applying the runs over the previous one
+class delta_frames {
+
+	struct pixel_run {
+		uint32_t y;
+		uint32_t x;
+		uint32_t length;
+	};
+
+	struct delta {
+		std::vector<pixel_run> runs;
+		std::vector<uint8_t> pixels;
+		constraint changed;
+		bool ready = false;
+	};
+
+	int m_width;
+	int m_height;
+	size_t m_bytes;
+	size_t m_pitch;
+	int m_rendered = 0;
+
+	std::vector<delta> m_deltas;
+
+	// frame being rendered, the one rendered before it and the first one, the
+	// latter is only kept until the last frame can be compared against it
+	arena_buffer<uint8_t> m_current;
+	arena_buffer<uint8_t> m_previous;
+	arena_buffer<uint8_t> m_first;
+
+	// Store the runs of pixels in which the frame differs from the previous one
+	static delta encode(const uint8_t* frame, const uint8_t* previous, int width, int height, size_t bytes);
+
+public:
+
+	delta_frames(int width, int height, int frames, size_t bytes);
+
+	// Check if the runs of the given frame were already stored, for
+	// the first frame that happens only once the last one was rendered
+	bool is_ready(int frame) const;
+
+	// Buffer to render the next frame into, of height() rows of pitch() bytes
+	uint8_t* scratch();
+
+	// Store the frame just rendered into scratch(), which has to be the one following the frame rendered
+	// before it, returns the part that differs from that frame (the first one differs everywhere)
+	constraint set_ready(int frame);
+
+	// The frame most recently passed to set_ready(), until release_latest() is called
+	const uint8_t* latest() const;
+
+	// Free the frame returned by latest(), once the last frame was stored and shown
+	// only the runs are kept, as the frames are then just replayed with apply()
+	void release_latest();
+
+	// Write the runs of the frame into a buffer with the given stride, which has to hold
+	// the frame before it (or the last one, for the first), returns the changed part
+	constraint apply(int frame, uint8_t* dst, size_t stride) const;
+
+	// Line length, in bytes, of scratch() and latest()
+	size_t pitch() const;
+
+	// Number of frames this cache can hold
+	int frame_count() const;
+
+	// Total size, in bytes, of the stored runs
+	size_t size() const;
+};
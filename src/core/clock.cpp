@@ -0,0 +1,51 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "clock.hpp"
+
+// region frame_clock
+
+frame_clock::frame_clock() {
+	restart();
+}
+
+void frame_clock::restart() {
+	clock_gettime(CLOCK_MONOTONIC, &m_deadline);
+}
+
+void frame_clock::advance(long us) {
+	m_deadline.tv_sec += us / 1'000'000;
+	m_deadline.tv_nsec += (us % 1'000'000) * 1000;
+
+	if (m_deadline.tv_nsec >= 1'000'000'000) {
+		m_deadline.tv_sec++;
+		m_deadline.tv_nsec -= 1'000'000'000;
+	} else if (m_deadline.tv_nsec < 0) {
+		m_deadline.tv_sec--;
+		m_deadline.tv_nsec += 1'000'000'000;
+	}
+}
+
+long frame_clock::lag() const {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - m_deadline.tv_sec) * 1'000'000 + (now.tv_nsec - m_deadline.tv_nsec) / 1000;
+}
+
+void frame_clock::wait() const {
+	// with an absolute deadline there is no drift, even if the sleep is cut short
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &m_deadline, nullptr);
+}
@@ -0,0 +1,42 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <ctime>
+
+// Keeps absolute presentation deadlines on the monotonic clock, so the
+// time spent drawing a frame never delays the ones that follow it
+class frame_clock {
+
+	timespec m_deadline;
+
+public:
+
+	// Start counting from the current time
+	frame_clock();
+
+	// Move the deadline to the current time
+	void restart();
+
+	// Move the deadline forward by the given number of microseconds
+	void advance(long us);
+
+	// Number of microseconds by which the deadline was missed, negative if it's still ahead
+	long lag() const;
+
+	// Sleep until the deadline, returns early if interrupted by a signal
+	void wait() const;
+};
@@ -0,0 +1,59 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "compositor.hpp"
+
+#include <algorithm>
+
+// region compositor
+
+void compositor::add(const image& img, int z) {
+	m_layers.push_back({&img, z});
+}
+
+void compositor::remove(const image& img) {
+	std::erase_if(m_layers, [&](const layer& entry) { return entry.img == &img; });
+}
+
+void compositor::clear() {
+	m_layers.clear();
+}
+
+size_t compositor::size() const {
+	return m_layers.size();
+}
+
+void compositor::compose(screen& target) const {
+	std::vector<layer> ordered = m_layers;
+
+	std::stable_sort(ordered.begin(), ordered.end(), [](const layer& a, const layer& b) {
+		return a.z < b.z;
+	});
+
+	// the layers are blended with each other in system memory, the device is only read
+	// under parts of blended layers that aren't above any layer drawn before them
+	target.begin_batch();
+
+	try {
+		for (const layer& entry : ordered) {
+			target.blit(*entry.img);
+		}
+	} catch (...) {
+		target.end_batch();
+		throw;
+	}
+
+	target.end_batch();
+}
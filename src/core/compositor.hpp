@@ -0,0 +1,52 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <vector>
+
+#include "image.hpp"
+#include "screen.hpp"
+
+// Image layers composed off-screen in z-order, each with its own placement and blending (set
+// on the image), the screen is then written only where the layers are and flushed once
+class compositor {
+
+	struct layer {
+		const image* img;
+		int z;
+	};
+
+	std::vector<layer> m_layers;
+
+public:
+
+	// Add the image above all layers with a lower z, layers with equal z are drawn in the
+	// order they were added, the image is not copied, so it has to outlive the layer
+	void add(const image& img, int z = 0);
+
+	// Remove the layers showing the image
+	void remove(const image& img);
+
+	// Remove all layers
+	void clear();
+
+	// Number of layers
+	size_t size() const;
+
+	// Draw all layers into the screen as a single update, blended layers blend with
+	// the layers below them, and with what the screen showed under the lowest one
+	void compose(screen& target) const;
+};
@@ -22,3 +22,38 @@
 #define FB_ENV_PATH "FB_PATH"
 #define DRM_ENV_CONN "DRM_CONNECTOR"
 #define DRM_ENV_PATH "DRM_PATH"
+#define DRM_ENV_CACHE "DRM_PROBE_CACHE"
+
+// number of DRM scanout buffers, 1 disables page flipping
+#define DRM_DEFAULT_BUFFERS 2
+#define DRM_MAX_BUFFERS 3
+
+// number of decoded animation frames kept in memory, at least 3
+#define GIF_STREAM_FRAMES 3
+
+// still images with more than one run of visible pixels per this many pixels are not indexed
+#define IMAGE_SPAN_PIXELS 16
+
+// alignment of buffers from the arena, enough for the widest vector instructions
+#define ARENA_ALIGNMENT 64
+
+// smaller buffers come from the regular heap, larger ones are mapped and kept for reuse
+#define ARENA_MIN_BYTES (256 * 1024)
+
+// buffers at least this large are rounded up to, and backed by, huge pages
+#define ARENA_HUGE_PAGE (2 * 1024 * 1024)
+
+// most memory kept in released buffers, beyond that the oldest ones are unmapped
+#define ARENA_KEPT_BYTES (64 * 1024 * 1024)
+
+// delta cached frames merge runs of changed pixels separated by fewer unchanged ones than this
+#define CACHE_DELTA_GAP 8
+
+// number of animation frames converted ahead of the one being shown
+#define SCREEN_QUEUE_FRAMES 3
+
+// minimum number of pixels drawn by each thread, so small regions don't pay for synchronization
+#define SCREEN_BAND_PIXELS (64 * 1024)
+
+// animations that fall further behind than this (in microseconds) restart their schedule instead of dropping frames
+#define SCREEN_MAX_LAG_US 1'000'000
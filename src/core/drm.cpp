@@ -14,31 +14,206 @@
 
 #include "drm.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <stdexcept>
 #include <vector>
 
 #include "logger.hpp"
+#include <cerrno>
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 #include "config.hpp"
+#include "kernels.hpp"
+#include "stats.hpp"
+
+// added in Linux 6.8, older headers don't have it
+#ifndef DRM_IOCTL_MODE_CLOSEFB
+struct drm_mode_closefb {
+	uint32_t fb_id;
+	uint32_t pad;
+};
+
+#define DRM_IOCTL_MODE_CLOSEFB DRM_IOWR(0xD0, struct drm_mode_closefb)
+#endif
+
+// Copy the rows of a region of 32 bit pixels between buffers with different line lengths
+static void copy_rows(const void* from, int from_pitch, void* to, int to_pitch, constraint region) {
+	const auto* src = static_cast<const uint8_t*>(from) + region.min.y * from_pitch + region.min.x * 4;
+	auto* dst = static_cast<uint8_t*>(to) + region.min.y * to_pitch + region.min.x * 4;
+
+	for (int y = 0; y < region.height(); y++) {
+		memcpy(dst + y * to_pitch, src + y * from_pitch, region.width() * 4);
+	}
+}
 
-// region drm
+static void premultiply_row(uint8_t* dst, const uint8_t* src, int count) {
+	for (int i = 0; i < count; i++) {
+		const uint8_t* pixel = src + i * 4;
+		const uint32_t alpha = pixel[3];
+
+		const uint32_t encoded = (alpha << 24) | (div255_round(pixel[0] * alpha) << 16) | (div255_round(pixel[1] * alpha) << 8) | div255_round(pixel[2] * alpha);
+		memcpy(dst + i * 4, &encoded, 4);
+	}
+}
+
+// region drm_probe_cache
+
+drm_probe_cache::drm_probe_cache(const std::string& path)
+	: m_path(path) {
+
+	FILE* file = fopen(path.c_str(), "r");
+
+	if (file == nullptr) {
+		return;
+	}
+
+	// each line holds the key, connector, CRTC and the mode as hex bytes, separated by tabs
+	char line[1024];
+
+	while (fgets(line, sizeof(line), file)) {
+		char key[512];
+		char mode[512];
+		drm_probe probe{};
+
+		if (sscanf(line, "%511[^\t]\t%u\t%u\t%511s", key, &probe.connector, &probe.crtc, mode) != 4 || strlen(mode) != sizeof(drmModeModeInfo) * 2 || strspn(mode, "0123456789abcdef") != strlen(mode)) {
+			continue;
+		}
+
+		auto* bytes = reinterpret_cast<uint8_t*>(&probe.mode);
+
+		for (size_t i = 0; i < sizeof(drmModeModeInfo); i++) {
+			const char digits[3] = {mode[i * 2], mode[i * 2 + 1], 0};
+			bytes[i] = strtoul(digits, nullptr, 16);
+		}
+
+		m_probes[key] = probe;
+	}
+
+	fclose(file);
+}
+
+const drm_probe* drm_probe_cache::find(const std::string& key) const {
+	auto it = m_probes.find(key);
+	return it == m_probes.end() ? nullptr : &it->second;
+}
+
+void drm_probe_cache::store(const std::string& key, const drm_probe& probe) {
+	if (const drm_probe* known = find(key); known && memcmp(known, &probe, sizeof(probe)) == 0) {
+		return;
+	}
+
+	m_probes[key] = probe;
+
+	// like splash files, written next to the old file and then renamed over it
+	const std::string temporary = m_path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "w");
+
+	if (file == nullptr) {
+		LOG_WARN("Failed to open '%s' for writing!\n", temporary.c_str());
+		return;
+	}
+
+	bool written = true;
+
+	for (const auto& [name, entry] : m_probes) {
+		written = written && fprintf(file, "%s\t%u\t%u\t", name.c_str(), entry.connector, entry.crtc) > 0;
+
+		const auto* bytes = reinterpret_cast<const uint8_t*>(&entry.mode);
+
+		for (size_t i = 0; i < sizeof(drmModeModeInfo); i++) {
+			written = written && fprintf(file, "%02x", bytes[i]) > 0;
+		}
+
+		written = written && fputc('\n', file) != EOF;
+	}
+
+	if (fclose(file) != 0 || !written || rename(temporary.c_str(), m_path.c_str()) != 0) {
+		remove(temporary.c_str());
+		LOG_WARN("Failed to write DRM probe cache '%s'!\n", m_path.c_str());
+	}
+}
+
+// region drm_device
+
+drm_device::drm_device(int fd, const std::string& path)
+	: m_fd(fd), m_identity(path) {
+
+	m_resources = drmModeGetResources(fd);
+
+	if (!m_resources) {
+		close(fd);
+		throw std::runtime_error{"Unable to get DRM resources!"};
+	}
+
+	// the same path can point to a different card after drivers load in another order
+	if (auto version = drmGetVersion(fd)) {
+		m_identity += ":" + std::string(version->name, version->name_len);
+		drmFreeVersion(version);
+	}
+}
 
-drmModeResPtr drm::get_resource(int fd) {
-	auto resource = drmModeGetResources(fd);
+drm_device::~drm_device() {
+	drmModeFreeResources(m_resources);
+	close(m_fd);
+}
+
+int drm_device::try_opening(const char* path) {
+	if (path != nullptr) {
+		int fh = ::open(path, O_RDWR);
+		if (fh > 0) {
+			return fh;
+		}
+
+		LOG_WARN("Failed to open '%s'!\n", path);
+	}
+
+	return -1;
+}
+
+std::shared_ptr<drm_device> drm_device::open(const char* path) {
+	for (const char* candidate : {path, static_cast<const char*>(std::getenv(DRM_ENV_PATH)), DRM_DEV_1}) {
+		if (int fh = try_opening(candidate); fh > 0) {
+			return std::shared_ptr<drm_device>{new drm_device(fh, candidate)};
+		}
+	}
 
-	if (resource) {
-		return resource;
+	throw std::runtime_error("out of ideas, unable to open any framebuffer");
+}
+
+int drm_device::fd() const {
+	return m_fd;
+}
+
+const std::string& drm_device::identity() const {
+	return m_identity;
+}
+
+drmModeResPtr drm_device::resources() const {
+	return m_resources;
+}
+
+bool drm_device::claim(uint32_t crtc) {
+	if (std::find(m_claimed.begin(), m_claimed.end(), crtc) != m_claimed.end()) {
+		return false;
 	}
 
-	throw std::runtime_error{"Unable to get DRM resources!"};
+	m_claimed.push_back(crtc);
+	return true;
+}
+
+void drm_device::release(uint32_t crtc) {
+	std::erase(m_claimed, crtc);
 }
 
+// region drm
+
 drmModeConnectorPtr drm::pick_connector(int fd, drmModeResPtr resource, size_t index) {
 
 	std::vector<drmModeConnectorPtr> connectors;
@@ -126,124 +301,576 @@ drmModeCrtcPtr drm::get_crtc(int fd, drmModeConnectorPtr connector) {
 	return crtc;
 }
 
-bool drm::try_using(const char* path, size_t conn, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint) {
-	if (path != nullptr) {
-		int fh = open(path, O_RDWR);
-		if (fh > 0) {
-			init(fh, conn, hdisplay_hint, vdisplay_hint, vrefresh_hint);
-			return true;
-		}
+drmModeModeInfoPtr drm::get_active_mode(drmModeCrtcPtr crtc, drmModeConnectorPtr connector, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint) {
+	if (!crtc->mode_valid) {
+		return nullptr;
+	}
 
-		LOG_WARN("Failed to open '%s'!\n", path);
+	const drmModeModeInfo& active = crtc->mode;
+	const bool hinted = hdisplay_hint != 0 && hdisplay_hint != uint16_t(-1);
+
+	if (hinted && (active.hdisplay != hdisplay_hint || active.vdisplay != vdisplay_hint || (vrefresh_hint != uint32_t(-1) && vrefresh_hint != 0 && active.vrefresh != vrefresh_hint))) {
+		return nullptr;
 	}
 
-	return false;
+	for (int i = 0; i < connector->count_modes; i++) {
+		if (memcmp(&connector->modes[i], &active, sizeof(active)) == 0) {
+			return &connector->modes[i];
+		}
+	}
+
+	return nullptr;
 }
 
-drm::drm(const char* path, uint16_t width, uint16_t height, uint32_t refresh) {
+bool drm::can_drive(int fd, drmModeResPtr resource, drmModeConnectorPtr connector, uint32_t crtc_id) {
+	int index = -1;
+
+	for (int i = 0; i < resource->count_crtcs; i++) {
+		if (resource->crtcs[i] == crtc_id) {
+			index = i;
+		}
+	}
+
+	if (index == -1) {
+		return false;
+	}
 
-	size_t output = 0;
+	for (int i = 0; i < connector->count_encoders; i++) {
+		auto encoder = drmModeGetEncoder(fd, connector->encoders[i]);
+
+		if (!encoder) {
+			continue;
+		}
 
-	const char* default_conn = std::getenv(DRM_ENV_CONN);
+		const bool possible = encoder->possible_crtcs & (1u << index);
+		drmModeFreeEncoder(encoder);
 
-	if (default_conn != nullptr) {
-		output = std::stoull(default_conn);
+		if (possible) {
+			return true;
+		}
 	}
 
-	if (path != nullptr) {
-		bool begin_display = false;
-		std::string wrapped{path};
-		std::string file, display;
+	return false;
+}
 
-		for (char c : wrapped) {
-			if (begin_display) {
-				display.push_back(c);
-			} else {
-				if (c == '@') {
-					begin_display = true;
-					continue;
-				}
+bool drm::reuse(const drm_probe& probe, drmModeResPtr resource) {
+	conn = drmModeGetConnectorCurrent(fd, probe.connector);
 
-				file.push_back(c);
+	if (conn && conn->connection != DRM_MODE_DISCONNECTED) {
+		for (int i = 0; i < conn->count_modes && !mode; i++) {
+			if (memcmp(&conn->modes[i], &probe.mode, sizeof(probe.mode)) == 0) {
+				mode = &conn->modes[i];
 			}
 		}
+	}
+
+	// after a hotplug the connector may be wired to a CRTC that can't drive it
+	if (mode && can_drive(fd, resource, conn, probe.crtc)) {
+		crtc = drmModeGetCrtc(fd, probe.crtc);
+	}
+
+	if (crtc) {
+		return true;
+	}
+
+	if (conn) {
+		drmModeFreeConnector(conn);
+	}
+
+	conn = nullptr;
+	mode = nullptr;
+	return false;
+}
 
-		if (!display.empty()) {
-			output = std::stoull(display.c_str());
+uint32_t drm::get_property(int fd, uint32_t object, uint32_t type, const char* name, uint64_t* value) {
+	auto properties = drmModeObjectGetProperties(fd, object, type);
+	uint32_t id = 0;
+
+	if (!properties) {
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < properties->count_props && id == 0; i++) {
+		auto property = drmModeGetProperty(fd, properties->props[i]);
+
+		if (!property) {
+			continue;
 		}
 
-		if (!file.empty() && try_using(file.c_str(), output, width, height, refresh)) {
-			return;
+		if (strcmp(property->name, name) == 0) {
+			id = property->prop_id;
+
+			if (value) {
+				*value = properties->prop_values[i];
+			}
 		}
-	}
 
-	if (try_using(std::getenv(DRM_ENV_PATH), output, width, height, refresh)) {
-		return;
+		drmModeFreeProperty(property);
 	}
 
-	if (try_using(DRM_DEV_1, output, width, height, refresh)) {
-		return;
+	drmModeFreeObjectProperties(properties);
+	return id;
+}
+
+void drm::on_page_flip(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec, void* user_data) {
+	(void)fd;
+	(void)sequence;
+	(void)tv_sec;
+	(void)tv_usec;
+
+	static_cast<drm*>(user_data)->pending = false;
+}
+
+drm::drm(std::shared_ptr<drm_device> device, size_t output, int count, uint16_t width, uint16_t height, uint32_t refresh, bool persist)
+	: device(std::move(device)), fd(this->device->fd()), persist(persist) {
+
+	if (count < 1 || count > DRM_MAX_BUFFERS) {
+		throw std::runtime_error{"Invalid DRM buffer count " + std::to_string(count) + ", expected 1 to " + std::to_string(DRM_MAX_BUFFERS)};
 	}
 
-	throw std::runtime_error("out of ideas, unable to open any framebuffer");
+	init(output, count, width, height, refresh);
 }
 
 drm::~drm() {
 
-	if (crtc) {
+	wait_for_flip();
+
+	if (overlay.enabled) {
+		drmSetMaster(fd);
+		commit_overlay(0, {}, {}, 0);
+	}
+
+	release(imported);
+
+	for (dumb_buffer& buffer : overlay.buffers) {
+		destroy_framebuffer(buffer);
+	}
+
+	// a persistent output keeps showing our last frame, if the kernel can't do that the CRTC is restored as usual
+	const bool kept = crtc && persist && modeset && keep(buffers[front]);
+
+	if (crtc && !kept) {
 		drmSetMaster(fd);
 		drmModeSetCrtc(fd, crtc->crtc_id, crtc->buffer_id, 0, 0, &conn->connector_id, 1, mode);
+	}
+
+	if (crtc) {
+
+		if (claimed) {
+			device->release(crtc->crtc_id);
+		}
+
 		drmModeFreeCrtc(crtc);
 	}
 
-	if (id) {
-		drmModeFreeFB(drmModeGetFB(fd, id));
+	for (size_t i = 0; i < buffers.size(); i++) {
+		if (buffers[i].adopted || (kept && i == front)) {
+			forget(buffers[i]);
+		} else {
+			destroy_framebuffer(buffers[i]);
+		}
 	}
 
 	if (conn) {
 		drmModeFreeConnector(conn);
 	}
+}
+
+void drm::wait_for_flip() {
+	drmEventContext context{};
+	context.version = 2;
+	context.page_flip_handler = on_page_flip;
+
+	while (pending) {
+		pollfd descriptor{fd, POLLIN, 0};
+
+		// a flip should never take more than a few frames
+		if (poll(&descriptor, 1, 1000) <= 0) {
+			LOG_WARN("Timed out waiting for DRM page flip!\n");
+			pending = false;
+			break;
+		}
+
+		drmHandleEvent(fd, &context);
+	}
+}
+
+void drm::copy_region(const dumb_buffer& from, dumb_buffer& to, constraint region) const {
+	region = get_constraint_intersection({region, {0, 0, width(), height()}});
+
+	if (!region.empty()) {
+		copy_rows(from.map, line_length(), to.map, line_length(), region);
+	}
+}
+
+bool drm::find_overlay() {
+	auto planes = drmModeGetPlaneResources(fd);
+
+	if (!planes) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < planes->count_planes && overlay.id == 0; i++) {
+		auto plane = drmModeGetPlane(fd, planes->planes[i]);
+
+		if (!plane) {
+			continue;
+		}
+
+		bool usable = (plane->possible_crtcs & (1 << crtc_index)) && (plane->crtc_id == 0 || plane->crtc_id == crtc->crtc_id);
+		bool has_format = false;
+
+		for (uint32_t f = 0; f < plane->count_formats; f++) {
+			has_format |= plane->formats[f] == DRM_FORMAT_ARGB8888;
+		}
+
+		uint64_t type = 0;
+		get_property(fd, plane->plane_id, DRM_MODE_OBJECT_PLANE, "type", &type);
+
+		if (usable && has_format && type == DRM_PLANE_TYPE_OVERLAY) {
+			overlay.id = plane->plane_id;
+		}
+
+		drmModeFreePlane(plane);
+	}
+
+	drmModeFreePlaneResources(planes);
+
+	if (overlay.id == 0) {
+		return false;
+	}
+
+	auto property = [&](const char* name) {
+		return get_property(fd, overlay.id, DRM_MODE_OBJECT_PLANE, name);
+	};
+
+	overlay.fb_id = property("FB_ID");
+	overlay.crtc_id = property("CRTC_ID");
+	overlay.src_x = property("SRC_X");
+	overlay.src_y = property("SRC_Y");
+	overlay.src_w = property("SRC_W");
+	overlay.src_h = property("SRC_H");
+	overlay.crtc_x = property("CRTC_X");
+	overlay.crtc_y = property("CRTC_Y");
+	overlay.crtc_w = property("CRTC_W");
+	overlay.crtc_h = property("CRTC_H");
+
+	return overlay.fb_id && overlay.crtc_id && overlay.src_x && overlay.src_y && overlay.src_w && overlay.src_h && overlay.crtc_x && overlay.crtc_y && overlay.crtc_w && overlay.crtc_h;
+}
+
+int drm::commit_overlay(uint32_t framebuffer, constraint source, constraint target, uint32_t flags) {
+	auto request = drmModeAtomicAlloc();
+
+	if (!request) {
+		return -ENOMEM;
+	}
+
+	const bool enable = framebuffer != 0;
+
+	// source coordinates are in 16.16 fixed point
+	drmModeAtomicAddProperty(request, overlay.id, overlay.fb_id, framebuffer);
+	drmModeAtomicAddProperty(request, overlay.id, overlay.crtc_id, enable ? crtc->crtc_id : 0);
+	drmModeAtomicAddProperty(request, overlay.id, overlay.src_x, uint64_t(source.min.x) << 16);
+	drmModeAtomicAddProperty(request, overlay.id, overlay.src_y, uint64_t(source.min.y) << 16);
+	drmModeAtomicAddProperty(request, overlay.id, overlay.src_w, uint64_t(source.width()) << 16);
+	drmModeAtomicAddProperty(request, overlay.id, overlay.src_h, uint64_t(source.height()) << 16);
+	drmModeAtomicAddProperty(request, overlay.id, overlay.crtc_x, target.min.x);
+	drmModeAtomicAddProperty(request, overlay.id, overlay.crtc_y, target.min.y);
+	drmModeAtomicAddProperty(request, overlay.id, overlay.crtc_w, target.width());
+	drmModeAtomicAddProperty(request, overlay.id, overlay.crtc_h, target.height());
+
+	int err = drmModeAtomicCommit(fd, request, flags, this);
+	drmModeAtomicFree(request);
+
+	overlay.enabled = enable && err == 0;
+	return err;
+}
+
+bool drm::show_overlay(const image& img, int frame, constraint source, constraint target) {
+	if (!atomic || source.empty() || target.empty()) {
+		return false;
+	}
+
+	// the overlay is placed on top of our primary buffer
+	if (!modeset) {
+		flush();
+	}
+
+	const int w = source.width();
+	const int h = source.height();
+
+	// (re)allocate plane buffers matching the shown part of the image
+	for (dumb_buffer& buffer : overlay.buffers) {
+		if (buffer.dumb.width != uint32_t(w) || buffer.dumb.height != uint32_t(h)) {
+			destroy_framebuffer(buffer);
+			create_framebuffer(buffer, w, h, 32, 32);
+			map(buffer);
+		}
+	}
+
+	dumb_buffer& buffer = overlay.buffers[overlay.back];
+
+	// the plane blends using premultiplied alpha, without blending
+	// the image is made opaque to match drawing into the primary buffer
+	const format argb{32, {8, 16}, {8, 8}, {8, 0}, {8, 24}};
+	const blitter& kernels = blitter::pick(argb);
+
+	const int src_pitch = img.width() * 4;
+	const uint8_t* src = img.data(frame) + source.min.y * src_pitch + source.min.x * 4;
+	auto* dst = static_cast<uint8_t*>(buffer.map);
+
+	for (int y = 0; y < h; y++) {
+		uint8_t* row = dst + y * buffer.dumb.pitch;
+
+		if (img.blend) {
+			premultiply_row(row, src + y * src_pitch, w);
+		} else {
+			kernels.copy(argb, row, src + y * src_pitch, w);
+		}
+	}
+
+	if (drmSetMaster(fd)) {
+		throw std::runtime_error{"Unable to acquire master access!"};
+	}
+
+	wait_for_flip();
+
+	constraint plane_source{0, 0, w, h};
+	uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK;
+
+	// make sure the driver accepts the plane configuration before using it
+	if (!overlay.enabled && commit_overlay(buffer.id, plane_source, target, DRM_MODE_ATOMIC_TEST_ONLY)) {
+		drmDropMaster(fd);
+		return false;
+	}
+
+	int err = commit_overlay(buffer.id, plane_source, target, flags);
+	drmDropMaster(fd);
+
+	if (err) {
+		LOG_WARN("Atomic overlay commit failed (err: %d)!\n", err);
+		return false;
+	}
+
+	pending = true;
+	overlay.back = (overlay.back + 1) % 2;
+
+	// the other buffer is still shown until the commit completes
+	wait_for_flip();
+	release(imported);
+	return true;
+}
+
+void drm::release(imported_buffer& buffer, uint32_t keep_handle) {
+	if (buffer.id) {
+		drmModeRmFB(fd, buffer.id);
+	}
+
+	// importing the same dmabuf again gives the same handle, which must stay open
+	if (buffer.handle && buffer.handle != keep_handle) {
+		drm_gem_close gem{};
+		gem.handle = buffer.handle;
+		drmIoctl(fd, DRM_IOCTL_GEM_CLOSE, &gem);
+	}
+
+	buffer = {};
+}
+
+bool drm::show_dmabuf(int dmabuf, int width, int height, int pitch, constraint source, constraint target) {
+	if (!atomic || source.empty() || target.empty()) {
+		return false;
+	}
+
+	// the overlay is placed on top of our primary buffer
+	if (!modeset) {
+		flush();
+	}
+
+	imported_buffer next{};
+
+	if (drmPrimeFDToHandle(fd, dmabuf, &next.handle)) {
+		LOG_WARN("Failed to import dmabuf!\n");
+		return false;
+	}
+
+	// RGBA in memory order is ABGR in the most to least significant bit order of DRM
+	const uint32_t handles[4] = {next.handle};
+	const uint32_t pitches[4] = {uint32_t(pitch)};
+	const uint32_t offsets[4] = {};
+
+	if (drmModeAddFB2(fd, width, height, DRM_FORMAT_ABGR8888, handles, pitches, offsets, &next.id, 0)) {
+		LOG_WARN("Failed to create framebuffer from dmabuf!\n");
+		release(next, imported.handle);
+		return false;
+	}
+
+	if (drmSetMaster(fd)) {
+		release(next, imported.handle);
+		throw std::runtime_error{"Unable to acquire master access!"};
+	}
+
+	wait_for_flip();
+
+	// make sure the driver can scan out this buffer before using it
+	int err = commit_overlay(next.id, source, target, DRM_MODE_ATOMIC_TEST_ONLY);
+
+	if (err == 0) {
+		err = commit_overlay(next.id, source, target, DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK);
+	}
+
+	drmDropMaster(fd);
+
+	if (err) {
+		LOG_WARN("Atomic overlay commit failed (err: %d)!\n", err);
+		release(next, imported.handle);
+		return false;
+	}
+
+	// the previous buffer is still shown until the commit completes
+	pending = true;
+	wait_for_flip();
+
+	release(imported, next.handle);
+	imported = next;
+	return true;
+}
+
+void drm::hide_overlay() {
+	if (!overlay.enabled) {
+		return;
+	}
+
+	if (drmSetMaster(fd)) {
+		throw std::runtime_error{"Unable to acquire master access!"};
+	}
+
+	wait_for_flip();
+	commit_overlay(0, {}, {}, 0);
+	drmDropMaster(fd);
 
-	if (dumb.handle) {
-		ioctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, dumb.handle);
+	release(imported);
+}
+
+void drm::invalidate(constraint region) {
+	damage = get_constraint_union({damage, region});
+}
+
+void drm::mirror(const drm& source, const void* pixels, int pitch) {
+	const constraint region = get_constraint_intersection({source.damage, {0, 0, width(), height()}});
+
+	if (region.empty()) {
+		return;
 	}
 
-	if (buffer) {
-		munmap(buffer, dumb.size);
+	// reading the buffer of the other output is slow, it's only done if there's no copy in system memory
+	if (pixels) {
+		copy_rows(pixels, pitch, data(), line_length(), region);
+	} else {
+		copy_rows(source.data(), source.line_length(), data(), line_length(), region);
 	}
 
-	close(fd);
+	invalidate(region);
 }
 
-void drm::flush() {
+void drm::flush(const void* shadow, int shadow_pitch) {
 	if (drmSetMaster(fd)) {
 		throw std::runtime_error{"Unable to acquire master access!"};
 	}
 
-	drmModeSetCrtc(fd, crtc->crtc_id, id, 0, 0, &conn->connector_id, 1, mode);
+	const dumb_buffer& drawn = buffers[back];
+
+	// only one flip can be queued at a time
+	wait_for_flip();
+
+	if (modeset && flipping && buffers.size() > 1) {
+		if (drmModePageFlip(fd, crtc->crtc_id, drawn.id, DRM_MODE_PAGE_FLIP_EVENT, this) == 0) {
+			pending = true;
+		} else {
+			LOG_WARN("DRM page flip failed, falling back to mode setting!\n");
+			flipping = false;
+		}
+	}
+
+	// the first frame always needs a full modeset to show our buffers, after that a single
+	// buffer is already scanned out, so only tell drivers that need it (e.g. over USB or SPI)
+	// which part was modified, most ignore this and the result is not worth checking
+	if (!pending && modeset && buffers.size() == 1) {
+		if (!damage.empty()) {
+			drmModeClip clip;
+			clip.x1 = damage.min.x;
+			clip.y1 = damage.min.y;
+			clip.x2 = damage.max.x;
+			clip.y2 = damage.max.y;
+
+			drmModeDirtyFB(fd, drawn.id, &clip, 1);
+		}
+	} else if (!pending) {
+		drmModeSetCrtc(fd, crtc->crtc_id, drawn.id, 0, 0, &conn->connector_id, 1, mode);
+		modeset = true;
+	}
+
 	drmDropMaster(fd);
+
+	if (buffers.size() == 1) {
+		damage = {};
+		return;
+	}
+
+	// all other buffers are now missing what was just drawn
+	for (size_t i = 0; i < buffers.size(); i++) {
+		if (i != back) {
+			buffers[i].stale = get_constraint_union({buffers[i].stale, damage});
+		}
+	}
+
+	damage = {};
+
+	const size_t previous = front;
+	front = back;
+	back = (back + 1) % buffers.size();
+
+	// the previous front buffer is scanned out until the flip completes
+	if (back == previous) {
+		wait_for_flip();
+	}
+
+	// bring the new back buffer up to date, so it can be drawn to incrementally, the
+	// shadow copy holds the same pixels as the front buffer, without reading device memory
+	dumb_buffer& next = buffers[back];
+	const constraint stale = get_constraint_intersection({next.stale, {0, 0, width(), height()}});
+
+	if (shadow && !stale.empty()) {
+		copy_rows(shadow, shadow_pitch, next.map, line_length(), stale);
+	} else if (!shadow) {
+		copy_region(buffers[front], next, stale);
+	}
+
+	next.stale = {};
 }
 
-void drm::map() {
+void drm::map(dumb_buffer& buffer) {
 	drm_mode_map_dumb map{};
 
 	memset(&map, 0, sizeof(map));
-	map.handle = dumb.handle;
+	map.handle = buffer.dumb.handle;
 
 	int err = drmIoctl(fd, DRM_IOCTL_MODE_MAP_DUMB, &map);
 	if (err) {
 		throw std::runtime_error{"Unable to mode-map dumb framebuffer (err: " + std::to_string(err) + ")!"};
 	}
 
-	buffer = mmap(nullptr, dumb.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, map.offset);
-	if (buffer == nullptr) {
+	buffer.map = mmap(nullptr, buffer.dumb.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, map.offset);
+	if (buffer.map == MAP_FAILED) {
+		buffer.map = nullptr;
 		throw std::runtime_error{"Unable to memory-map dumb framebuffer!"};
 	}
 }
 
-void drm::create_framebuffer(int depth, int bits_per_pixel) {
-	dumb.height = mode->vdisplay;
-	dumb.width = mode->hdisplay;
+void drm::create_framebuffer(dumb_buffer& buffer, int width, int height, int depth, int bits_per_pixel) {
+	drm_mode_create_dumb& dumb = buffer.dumb;
+
+	dumb.height = height;
+	dumb.width = width;
 	dumb.bpp = bits_per_pixel;
 
 	int err = ioctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &dumb);
@@ -251,57 +878,312 @@ void drm::create_framebuffer(int depth, int bits_per_pixel) {
 		throw std::runtime_error{"Unable to create dumb framebuffer (err: " + std::to_string(err) + ")!"};
 	}
 
-	err = drmModeAddFB(fd, dumb.width, dumb.height, depth, dumb.bpp, dumb.pitch, dumb.handle, &id);
+	err = drmModeAddFB(fd, dumb.width, dumb.height, depth, dumb.bpp, dumb.pitch, dumb.handle, &buffer.id);
 	if (err) {
 		throw std::runtime_error{"Unable to add framebuffer (err: " + std::to_string(err) + ")!"};
 	}
 }
 
-void drm::init(int fd, size_t output, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint) {
+void drm::destroy_framebuffer(dumb_buffer& buffer) {
+	if (buffer.map) {
+		munmap(buffer.map, buffer.dumb.size);
+	}
+
+	if (buffer.id) {
+		drmModeRmFB(fd, buffer.id);
+	}
+
+	if (buffer.dumb.handle) {
+		drm_mode_destroy_dumb destroy{};
+		destroy.handle = buffer.dumb.handle;
+		drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+	}
+
+	buffer = {};
+}
+
+void drm::forget(dumb_buffer& buffer) {
+	if (buffer.map) {
+		munmap(buffer.map, buffer.dumb.size);
+	}
+
+	// the framebuffer holds its own reference to the memory
+	if (buffer.dumb.handle) {
+		drm_gem_close gem{};
+		gem.handle = buffer.dumb.handle;
+		drmIoctl(fd, DRM_IOCTL_GEM_CLOSE, &gem);
+	}
+
+	buffer = {};
+}
+
+bool drm::keep(dumb_buffer& buffer) {
+
+	// it was created by someone else, so closing our device doesn't affect it
+	if (buffer.adopted) {
+		return true;
+	}
+
+	// closing the device would remove every framebuffer it created, and disable the CRTC
+	// scanning one out, unless it was closed first, which keeps it until it's replaced
+	drm_mode_closefb close{};
+	close.fb_id = buffer.id;
+
+	drmSetMaster(fd);
+
+	if (drmIoctl(fd, DRM_IOCTL_MODE_CLOSEFB, &close) != 0) {
+		LOG_WARN("Kernel can't keep the framebuffer on screen after exit (needs Linux 6.8+), persistence is not supported!\n");
+		return false;
+	}
+
+	return true;
+}
+
+bool drm::adopt(dumb_buffer& buffer) {
+	if (!crtc->buffer_id || !crtc->mode_valid || memcmp(&crtc->mode, mode, sizeof(*mode)) != 0) {
+		return false;
+	}
+
+	// handles are only given to the master
+	drmSetMaster(fd);
+	auto bound = drmModeGetFB2(fd, crtc->buffer_id);
+	drmDropMaster(fd);
+
+	if (!bound) {
+		return false;
+	}
+
+	const bool linear = !(bound->flags & DRM_MODE_FB_MODIFIERS) || bound->modifier == DRM_FORMAT_MOD_LINEAR;
+	const bool xrgb = bound->pixel_format == DRM_FORMAT_XRGB8888 || bound->pixel_format == DRM_FORMAT_ARGB8888;
+	const bool sized = bound->width == mode->hdisplay && bound->height == mode->vdisplay;
+
+	buffer.id = bound->fb_id;
+	buffer.adopted = true;
+	buffer.dumb.handle = bound->handles[0];
+	buffer.dumb.width = bound->width;
+	buffer.dumb.height = bound->height;
+	buffer.dumb.bpp = 32;
+	buffer.dumb.pitch = bound->pitches[0];
+	buffer.dumb.size = uint64_t(bound->pitches[0]) * bound->height;
+
+	const bool usable = linear && xrgb && sized && buffer.dumb.handle && bound->offsets[0] == 0;
+	drmModeFreeFB2(bound);
+
+	try {
+		if (usable) {
+			map(buffer);
+			return true;
+		}
+	} catch (const std::exception& e) {
+		LOG_WARN("Unable to draw into the framebuffer on screen: %s\n", e.what());
+	}
+
+	forget(buffer);
+	return false;
+}
+
+void drm::init(size_t output, int count, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint) {
+	stat_timer timer{"setup"};
 
 	try {
-		auto resource = get_resource(fd);
-		this->fd = fd;
+		auto resource = device->resources();
+
+		std::unique_ptr<drm_probe_cache> cache;
+		const std::string key = device->identity() + "@" + std::to_string(output) + ":" + std::to_string(hdisplay_hint) + "x" + std::to_string(vdisplay_hint) + "@" + std::to_string(vrefresh_hint);
+
+		// a cached output only needs its own connector checked, instead of all of them
+		if (const char* path = std::getenv(DRM_ENV_CACHE)) {
+			cache = std::make_unique<drm_probe_cache>(path);
+		}
+
+		if (const drm_probe* probe = cache ? cache->find(key) : nullptr; !probe || !reuse(*probe, resource)) {
+			this->conn = pick_connector(fd, resource, output);
+			this->crtc = get_crtc(fd, conn);
+			this->mode = get_active_mode(crtc, conn, hdisplay_hint, vdisplay_hint, vrefresh_hint);
+
+			if (!mode) {
+				this->mode = pick_mode(conn, hdisplay_hint, vdisplay_hint, vrefresh_hint);
+			}
+		}
+
+		if (cache) {
+			cache->store(key, {conn->connector_id, crtc->crtc_id, *mode});
+		}
+
+		// two outputs scanning out through one CRTC would show the same buffer
+		if (!device->claim(crtc->crtc_id)) {
+			throw std::runtime_error{"Output #" + std::to_string(output) + " is driven by CRTC " + std::to_string(crtc->crtc_id) + ", which is already used"};
+		}
+
+		claimed = true;
+
+		for (int i = 0; i < resource->count_crtcs; i++) {
+			if (resource->crtcs[i] == crtc->crtc_id) {
+				crtc_index = i;
+			}
+		}
+
+		buffers.resize(count);
+
+		// the adopted buffer is already scanned out with our mode, so no modeset is needed
+		const bool adopted = persist && adopt(buffers.front());
+
+		for (dumb_buffer& buffer : buffers) {
+			if (!buffer.adopted) {
+				create_framebuffer(buffer, mode->hdisplay, mode->vdisplay, 24, 32);
+				map(buffer);
+			}
+		}
+
+		// all buffers have to share the line length, as content is copied between them
+		if (adopted && std::any_of(buffers.begin(), buffers.end(), [&](const dumb_buffer& buffer) { return buffer.dumb.pitch != buffers.front().dumb.pitch; })) {
+			forget(buffers.front());
+			create_framebuffer(buffers.front(), mode->hdisplay, mode->vdisplay, 24, 32);
+			map(buffers.front());
+		} else if (adopted) {
+			modeset = true;
+
+			// keep showing the adopted buffer, and draw the next frames into copies of it
+			for (size_t i = 1; i < buffers.size(); i++) {
+				copy_region(buffers.front(), buffers[i], {0, 0, width(), height()});
+			}
 
-		this->conn = pick_connector(fd, resource, output);
-		this->mode = pick_mode(conn, hdisplay_hint, vdisplay_hint, vrefresh_hint);
-		this->crtc = get_crtc(fd, conn);
+			back = buffers.size() > 1 ? 1 : 0;
+		}
 
-		create_framebuffer(24, 32);
-		map();
+		// atomic modesetting is only used for overlay planes, so when
+		// any part of it is missing we just keep using the legacy API
+		if (crtc_index != -1 && drmSetClientCap(fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) == 0 && drmSetClientCap(fd, DRM_CLIENT_CAP_ATOMIC, 1) == 0) {
+			atomic = find_overlay();
+		}
 	} catch (const std::exception& e) {
+
+		// the destructor doesn't run when the constructor throws, and the device may still be used by other outputs
+		for (dumb_buffer& buffer : buffers) {
+			if (buffer.adopted) {
+				forget(buffer);
+			} else {
+				destroy_framebuffer(buffer);
+			}
+		}
+
+		buffers.clear();
+
+		for (dumb_buffer& buffer : overlay.buffers) {
+			destroy_framebuffer(buffer);
+		}
+
+		if (crtc) {
+			if (claimed) {
+				device->release(crtc->crtc_id);
+			}
+
+			drmModeFreeCrtc(crtc);
+		}
+
+		if (conn) {
+			drmModeFreeConnector(conn);
+		}
+
+		crtc = nullptr;
+		conn = nullptr;
+		mode = nullptr;
+		claimed = false;
+
 		throw std::runtime_error{"DMA init failed: " + std::string(e.what())};
 	}
 }
 
 int drm::width() const {
-	return dumb.width;
+	return buffers.front().dumb.width;
 }
 
 int drm::height() const {
-	return dumb.height;
+	return buffers.front().dumb.height;
 }
 
 int drm::line_length() const {
-	return dumb.pitch;
+	return buffers.front().dumb.pitch;
 }
 
 void* drm::data() const {
-	return buffer;
+	return buffers[back].map;
 }
 
 void drm::dump() const {
-	printf("Using DRM conn=%d, crtc=%d, type=%d (%dx%d)", conn->connector_id, crtc->crtc_id, conn->connector_type_id, width(), height());
+	printf("Using DRM conn=%d, crtc=%d, type=%d (%dx%d, %zu buffers)", conn->connector_id, crtc->crtc_id, conn->connector_type_id, width(), height(), buffers.size());
+
+	if (atomic) {
+		printf(" overlay plane=%d", overlay.id);
+	}
 }
 
 // region drm_screen
 
-drm_screen::drm_screen(const std::string& path, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint)
-	: fb(std::make_unique<drm>(path.empty() ? nullptr : path.c_str(), hdisplay_hint, vdisplay_hint, vrefresh_hint)) {
+// Parse '[path][@output[,output...]]', outputs not given are read from the environment
+static std::vector<size_t> parse_outputs(const std::string& path, std::string& file) {
+	std::vector<size_t> outputs;
+	const size_t at = path.find('@');
+
+	file = path.substr(0, at);
+
+	if (at != std::string::npos) {
+		for (size_t start = at + 1; start < path.size();) {
+			const size_t end = std::min(path.find(',', start), path.size());
+			outputs.push_back(std::stoull(path.substr(start, end - start)));
+			start = end + 1;
+		}
+	}
+
+	if (outputs.empty()) {
+		const char* default_conn = std::getenv(DRM_ENV_CONN);
+		outputs.push_back(default_conn ? std::stoull(default_conn) : 0);
+	}
+
+	return outputs;
+}
+
+drm_screen::drm_screen(const std::string& path, int buffers, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint, bool persist) {
+	std::string file;
+	const std::vector<size_t> indices = parse_outputs(path, file);
+	const auto device = drm_device::open(file.empty() ? nullptr : file.c_str());
+
+	for (size_t index : indices) {
+		outputs.push_back(std::make_unique<drm>(device, index, buffers, hdisplay_hint, vdisplay_hint, vrefresh_hint, persist));
+	}
+
+	share_frame();
+}
+
+drm_screen::drm_screen(const std::shared_ptr<drm_device>& device, const std::vector<size_t>& indices, int buffers, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint, bool persist) {
+	if (indices.empty()) {
+		throw std::runtime_error{"No DRM outputs given"};
+	}
+
+	for (size_t index : indices) {
+		outputs.push_back(std::make_unique<drm>(device, index, buffers, hdisplay_hint, vdisplay_hint, vrefresh_hint, persist));
+	}
+
+	share_frame();
+}
+
+void drm_screen::share_frame() {
+
+	// the frame is converted once into the shadow copy, from which all outputs
+	// are updated, so that none of them ever has to be read back
+	if (outputs.size() > 1) {
+		set_shadow(true);
+	}
 }
 
 void drm_screen::dump() {
-	fb->dump();
+	for (size_t i = 0; i < outputs.size(); i++) {
+		if (i) {
+			printf(", ");
+		}
+
+		outputs[i]->dump();
+	}
 
 	printf(" color format: ");
 	form().dump();
@@ -309,19 +1191,49 @@ void drm_screen::dump() {
 }
 
 int drm_screen::width() const {
-	return fb->width();
+	int width = outputs.front()->width();
+
+	for (const auto& output : outputs) {
+		width = std::min(width, output->width());
+	}
+
+	return width;
 }
 
 int drm_screen::height() const {
-	return fb->height();
+	int height = outputs.front()->height();
+
+	for (const auto& output : outputs) {
+		height = std::min(height, output->height());
+	}
+
+	return height;
 }
 
 int drm_screen::line_length() const {
-	return fb->line_length();
+	return outputs.front()->line_length();
 }
 
 void* drm_screen::data() const {
-	return fb->data();
+	return outputs.front()->data();
+}
+
+void drm_screen::invalidate(constraint region) {
+	outputs.front()->invalidate(region);
+}
+
+// planes only show on one output, so mirrored screens draw everything into the buffer instead
+
+bool drm_screen::overlay_frame(const image& img, int frame, constraint source, constraint target) {
+	return outputs.size() == 1 && outputs.front()->show_overlay(img, frame, source, target);
+}
+
+void drm_screen::hide_overlay() {
+	outputs.front()->hide_overlay();
+}
+
+bool drm_screen::scanout_dmabuf(int fd, int width, int height, int pitch, constraint source, constraint target) {
+	return outputs.size() == 1 && outputs.front()->show_dmabuf(fd, width, height, pitch, source, target);
 }
 
 format drm_screen::form() const {
@@ -329,5 +1241,13 @@ format drm_screen::form() const {
 }
 
 void drm_screen::flush() const {
-	fb->flush();
+
+	// the pixels were converted once, the other outputs only copy them
+	for (size_t i = 1; i < outputs.size(); i++) {
+		outputs[i]->mirror(*outputs.front(), shadow_data(), line_length());
+	}
+
+	for (const auto& output : outputs) {
+		output->flush(shadow_data(), line_length());
+	}
 }
@@ -15,41 +15,227 @@
 #pragma once
 
 #include <libdrm/drm.h>
+#include <libdrm/drm_fourcc.h>
 #include <libdrm/drm_mode.h>
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 
+#include "config.hpp"
 #include "screen.hpp"
 
+// Connector, CRTC and mode picked for an output
+struct drm_probe {
+	uint32_t connector = 0;
+	uint32_t crtc = 0;
+	drmModeModeInfo mode{};
+};
+
+// Outputs picked by earlier runs, stored in a file so that they can be checked and reused
+// without enumerating all connectors again, keyed by the device, output and mode hints
+class drm_probe_cache {
+
+	std::string m_path;
+	std::map<std::string, drm_probe> m_probes;
+
+public:
+
+	// Load the cache, a missing or malformed file gives an empty one
+	drm_probe_cache(const std::string& path);
+
+	// Find the probe stored with the key, nullptr if there is none
+	const drm_probe* find(const std::string& key) const;
+
+	// Store the probe with the key, writing the file if it changed
+	void store(const std::string& key, const drm_probe& probe);
+};
+
+// DRM device opened once and shared by all outputs driven from it, so its resources
+// are only enumerated once and the outputs don't have to compete for master access
+class drm_device {
+
+	int m_fd = -1;
+	drmModeResPtr m_resources = nullptr;
+	std::string m_identity;
+
+	// CRTCs already driven by one of the outputs
+	std::vector<uint32_t> m_claimed;
+
+	drm_device(int fd, const std::string& path);
+
+	static int try_opening(const char* path);
+
+public:
+
+	// Open the device at the given path, or the one from the environment or the default
+	// one if the path is null or can't be opened, throws if none of them can be opened
+	static std::shared_ptr<drm_device> open(const char* path);
+
+	~drm_device();
+
+	drm_device(const drm_device&) = delete;
+	drm_device& operator=(const drm_device&) = delete;
+
+	int fd() const;
+
+	// Path and driver name of the device, identifies it between runs
+	const std::string& identity() const;
+
+	// Resources enumerated when the device was opened
+	drmModeResPtr resources() const;
+
+	// Mark the CRTC as driven by an output, returns false if some other output already drives it
+	bool claim(uint32_t crtc);
+
+	// Release a CRTC marked with claim()
+	void release(uint32_t crtc);
+};
+
 class drm {
 
-	drm_mode_create_dumb dumb;
-	drmModeCrtcPtr crtc;
-	drmModeModeInfoPtr mode;
-	drmModeConnectorPtr conn;
-	uint32_t id;
-	int fd;
-	void* buffer;
+	struct dumb_buffer {
+		drm_mode_create_dumb dumb{};
+		uint32_t id = 0;
+		void* map = nullptr;
+
+		// Region drawn into other buffers since this one was last updated
+		constraint stale{};
+
+		// framebuffer was already on screen when we started, so it's not ours to remove
+		bool adopted = false;
+	};
+
+	// Hardware plane composited above the primary one, configured
+	// through atomic commits, so it needs the IDs of all used properties
+	struct overlay_plane {
+		uint32_t id = 0;
+
+		uint32_t fb_id = 0;
+		uint32_t crtc_id = 0;
+		uint32_t src_x = 0;
+		uint32_t src_y = 0;
+		uint32_t src_w = 0;
+		uint32_t src_h = 0;
+		uint32_t crtc_x = 0;
+		uint32_t crtc_y = 0;
+		uint32_t crtc_w = 0;
+		uint32_t crtc_h = 0;
+
+		dumb_buffer buffers[2];
+		size_t back = 0;
+		bool enabled = false;
+	};
+
+	// Buffer shared by another process, shown on the overlay plane
+	struct imported_buffer {
+		uint32_t id = 0;
+		uint32_t handle = 0;
+	};
+
+	std::vector<dumb_buffer> buffers;
+	size_t front = 0;
+	size_t back = 0;
+
+	overlay_plane overlay{};
+	imported_buffer imported{};
+	bool atomic = false;
+	int crtc_index = -1;
+
+	// Region of the back buffer modified since the last flush
+	constraint damage{};
+
+	drmModeCrtcPtr crtc = nullptr;
+	drmModeModeInfoPtr mode = nullptr;
+	drmModeConnectorPtr conn = nullptr;
+	std::shared_ptr<drm_device> device;
+	int fd = -1;
+	bool claimed = false;
+
+	bool modeset = false;
+	bool persist = false;
+	bool flipping = true;
+	bool pending = false;
 
-	static drmModeResPtr get_resource(int fd);
 	static drmModeConnectorPtr pick_connector(int fd, drmModeResPtr resource, size_t index);
 	static drmModeModeInfoPtr pick_mode(drmModeConnectorPtr connector, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint);
 	static drmModeCrtcPtr get_crtc(int fd, drmModeConnectorPtr connector);
 
-	void map();
-	void create_framebuffer(int depth, int bits_per_pixel);
-	void init(int fd, size_t output, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint);
+	// Get the mode the CRTC already scans out, if it matches the hints (or there are none)
+	// and the connector supports it, using it avoids changing the mode of the display
+	static drmModeModeInfoPtr get_active_mode(drmModeCrtcPtr crtc, drmModeConnectorPtr connector, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint);
+	static uint32_t get_property(int fd, uint32_t object, uint32_t type, const char* name, uint64_t* value = nullptr);
+	static void on_page_flip(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec, void* user_data);
+
+	void map(dumb_buffer& buffer);
+	void create_framebuffer(dumb_buffer& buffer, int width, int height, int depth, int bits_per_pixel);
+	void destroy_framebuffer(dumb_buffer& buffer);
+
+	// Unmap the buffer without removing its framebuffer, so that it can stay on screen
+	void forget(dumb_buffer& buffer);
+
+	// Let the framebuffer outlive the device, so that it stays on screen, returns false if unsupported
+	bool keep(dumb_buffer& buffer);
+
+	// Draw into the framebuffer our CRTC already scans out, instead of a new one,
+	// returns false if it's not a linear 32 bit buffer of the mode size that can be mapped
+	bool adopt(dumb_buffer& buffer);
+	// Use the connector, CRTC and mode picked by an earlier run, returns false if they're no longer valid
+	bool reuse(const drm_probe& probe, drmModeResPtr resource);
 
-	bool try_using(const char* path, size_t conn, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint);
+	// Check if one of the encoders of the connector can be driven by the CRTC
+	static bool can_drive(int fd, drmModeResPtr resource, drmModeConnectorPtr connector, uint32_t crtc_id);
+
+	void init(size_t output, int count, uint16_t hdisplay_hint, uint16_t vdisplay_hint, uint32_t vrefresh_hint);
+
+	// Block until the queued page flip, if any, completes
+	void wait_for_flip();
+
+	// Copy the given region between two buffers
+	void copy_region(const dumb_buffer& from, dumb_buffer& to, constraint region) const;
+
+	// Find an overlay plane usable with our CRTC, returns false if there is none
+	bool find_overlay();
+
+	// Atomically update the overlay plane, pass a zero framebuffer to disable it
+	int commit_overlay(uint32_t framebuffer, constraint source, constraint target, uint32_t flags);
+
+	// Remove the framebuffer of an imported buffer, unless the plane still uses it,
+	// the handle is kept if the next imported buffer resolved to the same one
+	void release(imported_buffer& buffer, uint32_t keep_handle = 0);
 
 public:
 
-	drm(const char* path, uint16_t hdisplay_hint = 0, uint16_t vdisplay_hint = 0, uint32_t vrefresh_hint = 0);
+	// Drive the output (index of a connected connector) of the device, a persistent output starts
+	// drawing into the framebuffer already on screen, if possible, and leaves its own one there on exit
+	drm(std::shared_ptr<drm_device> device, size_t output, int buffers = 1, uint16_t hdisplay_hint = 0, uint16_t vdisplay_hint = 0, uint32_t vrefresh_hint = 0, bool persist = false);
 	~drm();
 
-	// Update the screen to match the buffer
-	void flush();
+	// Mark region of the buffer returned by data() as modified
+	void invalidate(constraint region);
+
+	// Copy the region of the other output modified since its last flush into our buffer, so both show the
+	// same pixels (clipped to our size) once flushed, call before its flush(), the pixels are copied from
+	// the shadow copy of the screen (with the given line length), if given, instead of the other output
+	void mirror(const drm& source, const void* pixels = nullptr, int pitch = 0);
+
+	// Present the buffer returned by data() on the screen, with multiple buffers this page flips on the next
+	// vblank and switches data() to the next buffer, which is brought up to date from the shadow copy of the
+	// screen (with the given line length), if one is given, instead of reading back the buffer just shown
+	void flush(const void* shadow = nullptr, int shadow_pitch = 0);
+
+	// Show the source rectangle of an image frame at the target rectangle using
+	// a hardware overlay plane, returns false if that's not supported
+	bool show_overlay(const image& img, int frame, constraint source, constraint target);
+
+	// Show the source rectangle of a dmabuf with RGBA pixels at the target rectangle
+	// using the hardware overlay plane, no copy is made, returns false if unsupported
+	bool show_dmabuf(int dmabuf, int width, int height, int pitch, constraint source, constraint target);
+
+	// Disable the hardware overlay plane, if it's used
+	void hide_overlay();
 
 	// Get width, in pixels
 	int width() const;
@@ -67,17 +253,30 @@ public:
 	void dump() const;
 };
 
+// Screen shown on one or more outputs of a DRM device, everything is drawn once into
+// the first output and mirrored to the others, which are cropped to the smallest of them
 class drm_screen : public screen {
 
-	std::unique_ptr<drm> fb;
+	std::vector<std::unique_ptr<drm>> outputs;
+
+	// Keep the shadow copy when mirroring, so outputs are updated from system memory
+	void share_frame();
 
 protected:
 
 	void* data() const override;
+	void invalidate(constraint region) override;
+	bool overlay_frame(const image& img, int frame, constraint source, constraint target) override;
+	void hide_overlay() override;
+	bool scanout_dmabuf(int fd, int width, int height, int pitch, constraint source, constraint target) override;
 
 public:
 
-	drm_screen(const std::string& path, uint16_t hdisplay_hint = -1, uint16_t vdisplay_hint = -1, uint32_t vrefresh_hint = -1);
+	// Open the device given as '[path][@output[,output...]]', see drm::drm() for persist
+	drm_screen(const std::string& path, int buffers = DRM_DEFAULT_BUFFERS, uint16_t hdisplay_hint = -1, uint16_t vdisplay_hint = -1, uint32_t vrefresh_hint = -1, bool persist = false);
+
+	// Drive the given outputs of an opened device, other screens can use its other outputs
+	drm_screen(const std::shared_ptr<drm_device>& device, const std::vector<size_t>& outputs, int buffers = DRM_DEFAULT_BUFFERS, uint16_t hdisplay_hint = -1, uint16_t vdisplay_hint = -1, uint32_t vrefresh_hint = -1, bool persist = false);
 
 	void dump() override;
 	int width() const override;
@@ -0,0 +1,130 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "file.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILE_READ_CHUNK 65536
+
+// region file_view
+
+file_view::file_view(const std::string& path) {
+	const bool standard_input = path == "-";
+	const int fd = standard_input ? STDIN_FILENO : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open '" + path + "'");
+	}
+
+	struct stat info{};
+
+	// regular files can be mapped, the decoders read them front to back
+	// exactly once, so let the kernel read ahead and drop pages early
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+		void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (map != MAP_FAILED) {
+			madvise(map, info.st_size, MADV_SEQUENTIAL);
+
+			m_data = static_cast<uint8_t*>(map);
+			m_size = info.st_size;
+			m_mapped = true;
+		}
+	}
+
+	if (!m_mapped) {
+		try {
+			read_all(fd, path);
+		} catch (...) {
+			free(m_data);
+
+			if (!standard_input) {
+				close(fd);
+			}
+
+			throw;
+		}
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	if (!standard_input) {
+		close(fd);
+	}
+
+	if (m_size == 0) {
+		free(m_data);
+		throw std::runtime_error("Failed to read '" + path + "', file is empty");
+	}
+}
+
+file_view::~file_view() {
+	if (m_mapped) {
+		munmap(m_data, m_size);
+	} else {
+		free(m_data);
+	}
+}
+
+void file_view::read_all(int fd, const std::string& path) {
+	size_t capacity = 0;
+
+	while (true) {
+		if (m_size == capacity) {
+			capacity += FILE_READ_CHUNK;
+			auto* grown = static_cast<uint8_t*>(realloc(m_data, capacity));
+
+			if (grown == nullptr) {
+				throw std::runtime_error("Out of memory while reading '" + path + "'");
+			}
+
+			m_data = grown;
+		}
+
+		const ssize_t count = read(fd, m_data + m_size, capacity - m_size);
+
+		if (count == 0) {
+			return;
+		}
+
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			throw std::runtime_error("Failed to read '" + path + "'");
+		}
+
+		m_size += count;
+	}
+}
+
+const uint8_t* file_view::data() const {
+	return m_data;
+}
+
+size_t file_view::size() const {
+	return m_size;
+}
+
+bool file_view::is_mapped() const {
+	return m_mapped;
+}
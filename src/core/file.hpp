@@ -0,0 +1,49 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only contents of a whole file, memory mapped when possible and
+// read into memory otherwise (pipes, character devices), "-" is stdin
+class file_view {
+
+	uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_mapped = false;
+
+	// Read everything until end of file into a heap buffer
+	void read_all(int fd, const std::string& path);
+
+public:
+
+	file_view(const std::string& path);
+	~file_view();
+
+	file_view(const file_view&) = delete;
+	file_view& operator=(const file_view&) = delete;
+
+	// Get pointer to the first byte of the file
+	const uint8_t* data() const;
+
+	// Get file size, in bytes
+	size_t size() const;
+
+	// Check if the contents are mapped directly from the page cache
+	bool is_mapped() const;
+};
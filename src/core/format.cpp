@@ -34,6 +34,10 @@ uint8_t channel::decode(size_t value) const {
 	return (field * 255) / mask;
 }
 
+bool channel::operator==(const channel& other) const {
+	return length == other.length && (length == 0 || offset == other.offset);
+}
+
 void channel::dump(const char* name) const {
 	printf("%s=%02x@%d ", name, mask, offset);
 }
@@ -76,3 +80,7 @@ void format::decode_rgb(size_t pixel, uint8_t* dr, uint8_t* dg, uint8_t* db) con
 	*dg = g.decode(pixel);
 	*db = b.decode(pixel);
 }
+
+bool format::operator==(const format& other) const {
+	return bits == other.bits && r == other.r && g == other.g && b == other.b && a == other.a;
+}
@@ -38,6 +38,10 @@ struct channel {
 	// Given an encoded pixel return back the channel value
 	uint8_t decode(size_t value) const;
 
+	// Check if both channels describe the same layout, the offset
+	// of unused channels is ignored
+	bool operator==(const channel& other) const;
+
 	// Print simple overview to the standard output
 	void dump(const char* name) const;
 };
@@ -71,4 +75,7 @@ struct format {
 
 	// given an encoded pixel computes the stored RGB values
 	void decode_rgb(size_t pixel, uint8_t* r, uint8_t* g, uint8_t* b) const;
+
+	// Check if both formats describe the same pixel layout
+	bool operator==(const format& other) const;
 };
@@ -13,15 +13,23 @@
 // limitations under the License.
 
 #include "image.hpp"
+#include <climits>
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include "config.hpp"
+#include "file.hpp"
+#include "logger.hpp"
+#include "scale.hpp"
+#include "stats.hpp"
+
 #define RGBA_CHANNELS 4
 
-// region image
+// region helpers
 
 static bool is_gif(const uint8_t* buffer, int len) {
 	stbi__context s;
@@ -30,32 +38,310 @@ static bool is_gif(const uint8_t* buffer, int len) {
 	return stbi__gif_test(&s);
 }
 
-static uint8_t* read_file_into_buffer(const std::string& path, int* bytes) {
-	FILE* file = stbi__fopen(path.c_str(), "rb");
-	if (!file)
-		throw std::runtime_error("Failed to open image '" + path + "'");
+// Count GIF image descriptors by walking the block structure, without decompressing anything
+static int count_gif_frames(const uint8_t* buffer, int len) {
+	int frames = 0;
+
+	// header and logical screen descriptor
+	int at = 13;
+
+	if (len < at) {
+		return 0;
+	}
+
+	const auto skip_color_table = [&](uint8_t flags) {
+		if (flags & 0x80) {
+			at += 3 * (2 << (flags & 7));
+		}
+	};
+
+	const auto skip_sub_blocks = [&]() {
+		while (at < len && buffer[at]) {
+			at += buffer[at] + 1;
+		}
+
+		at++;
+	};
+
+	skip_color_table(buffer[10]);
+
+	while (at < len) {
+		switch (buffer[at++]) {
+			case 0x21: // extension, label followed by data
+				at++;
+				skip_sub_blocks();
+				break;
+
+			case 0x2C: // image, descriptor followed by LZW code size and data
+				if (at + 9 > len) {
+					return frames;
+				}
+
+				skip_color_table(buffer[at + 8]);
+				at += 10;
+				skip_sub_blocks();
+				frames++;
+				break;
+
+			default: // trailer
+				return frames;
+		}
+	}
+
+	return frames;
+}
+
+// Computes the bounding box of pixels that differ between two frames
+static constraint get_difference(const uint8_t* first, const uint8_t* second, int w, int h) {
+	constraint box{};
+	const size_t pitch = w * RGBA_CHANNELS;
+
+	for (int y = 0; y < h; y++) {
+		const uint8_t* a = first + y * pitch;
+		const uint8_t* b = second + y * pitch;
+
+		if (memcmp(a, b, pitch) == 0) {
+			continue;
+		}
+
+		int left = 0;
+		int right = w - 1;
+
+		while (memcmp(a + left * RGBA_CHANNELS, b + left * RGBA_CHANNELS, RGBA_CHANNELS) == 0) {
+			left++;
+		}
+
+		while (memcmp(a + right * RGBA_CHANNELS, b + right * RGBA_CHANNELS, RGBA_CHANNELS) == 0) {
+			right--;
+		}
+
+		box = get_constraint_union({box, {left, y, right - left + 1, 1}});
+	}
+
+	return box;
+}
+
+// region frame_stream
+
+// GIF decoder state, frames are decoded sequentially into a small ring and
+// the decoder is restarted from the beginning when an older frame is needed
+struct image::frame_stream {
+
+	// compressed file, kept for as long as the stream
+	std::unique_ptr<file_view> file;
+
+	stbi__context context;
+	stbi__gif gif;
+
+	int width = 0;
+	int height = 0;
+	int count;
+
+	// frame the decoder produces next
+	int next = 0;
+
+	// number of leading frames that were decoded at least once
+	int measured = 0;
+
+	// set if the file ended before all declared frames were decoded
+	bool ended = false;
+
+	// per-frame delays in milliseconds, 0 if the file doesn't specify one
+	std::vector<int> delays;
+
+	// decoded frames, the oldest one is overwritten first
+	size_t decoded = 0;
+	int held[GIF_STREAM_FRAMES];
+	arena_buffer<uint8_t> ring;
+
+	// size frames are scaled to, the decoder needs frames in their
+	// original size, so the scaled ones are kept in a separate ring
+	int scaled_width = 0;
+	int scaled_height = 0;
+	size_t scaled_count = 0;
+	int scaled_held[GIF_STREAM_FRAMES];
+	arena_buffer<uint8_t> scaled_ring;
+
+	frame_stream(std::unique_ptr<file_view> file, int count);
+	~frame_stream();
+
+	// Get decoded frame from the ring, or nullptr if it's not there
+	uint8_t* find(int frame);
+
+	// Decode the next frame, and record how it differs from the previous one
+	uint8_t* decode(std::vector<constraint>& changes);
+
+	// Get decoded frame, decoding as many frames as needed
+	uint8_t* fetch(int frame, std::vector<constraint>& changes);
+
+	// Same as fetch(), but scaled if the stream is resized
+	uint8_t* fetch_scaled(int frame, std::vector<constraint>& changes);
+
+	void restart();
+};
+
+image::frame_stream::frame_stream(std::unique_ptr<file_view> file, int count)
+	: file(std::move(file)), count(count) {
+
+	memset(&gif, 0, sizeof(gif));
+	stbi__start_mem(&context, this->file->data(), this->file->size());
+
+	for (int& frame : held) {
+		frame = -1;
+	}
+
+	for (int& frame : scaled_held) {
+		frame = -1;
+	}
+}
+
+image::frame_stream::~frame_stream() {
+	STBI_FREE(gif.out);
+	STBI_FREE(gif.background);
+	STBI_FREE(gif.history);
+}
+
+uint8_t* image::frame_stream::find(int frame) {
+	const size_t size = width * height * RGBA_CHANNELS;
+
+	for (int i = 0; i < GIF_STREAM_FRAMES; i++) {
+		if (frame >= 0 && held[i] == frame) {
+			return ring.data() + i * size;
+		}
+	}
+
+	return nullptr;
+}
+
+uint8_t* image::frame_stream::decode(std::vector<constraint>& changes) {
+	stat_timer timer{"decode"};
+	const int frame = next;
+	uint8_t* out = nullptr;
+
+	if (!ended) {
+		int unused_channel_count = 0;
+		out = stbi__gif_load_next(&context, &gif, &unused_channel_count, RGBA_CHANNELS, find(frame - 2));
+
+		// the end of file marker is the context pointer
+		if (out == reinterpret_cast<uint8_t*>(&context)) {
+			out = nullptr;
+		}
+	}
+
+	if (out == nullptr) {
+		if (gif.out == nullptr) {
+			return nullptr;
+		}
+
+		if (!ended) {
+			LOG_WARN("Animation ended after %d out of %d frames, repeating the last one!\n", frame, count);
+			ended = true;
+		}
+
+		out = gif.out;
+	}
+
+	// the size is only known once the first frame is decoded
+	if (ring.empty()) {
+		width = gif.w;
+		height = gif.h;
+
+		ring = arena_buffer<uint8_t>(size_t(GIF_STREAM_FRAMES) * width * height * RGBA_CHANNELS);
+		changes.assign(count, {0, 0, width, height});
+		delays.assign(count, 0);
+	}
+
+	const size_t size = width * height * RGBA_CHANNELS;
+	const size_t slot = decoded % GIF_STREAM_FRAMES;
+
+	// look up the previous frame before it can be overwritten
+	// the first frame follows the last one when looping
+	if (const uint8_t* previous = find(frame == 0 ? count - 1 : frame - 1)) {
+		changes[frame] = get_difference(out, previous, width, height);
+	}
+
+	uint8_t* pixels = ring.data() + slot * size;
+	memcpy(pixels, out, size);
+
+	// stb reads the delay from the graphic control extension before the frame
+	delays[frame] = gif.delay;
+
+	held[slot] = frame;
+	decoded++;
+	next++;
+
+	if (measured == frame) {
+		measured++;
+	}
+
+	return pixels;
+}
+
+uint8_t* image::frame_stream::fetch(int frame, std::vector<constraint>& changes) {
+	if (uint8_t* pixels = find(frame)) {
+		return pixels;
+	}
+
+	if (frame < next) {
+		restart();
+	}
+
+	uint8_t* pixels = nullptr;
 
-	fseek(file, 0, SEEK_END);
-	int size = ftell(file);
-	fseek(file, 0, SEEK_SET);
+	while (next <= frame) {
+		pixels = decode(changes);
 
-	*bytes = size;
+		// nothing could be decoded at all
+		if (pixels == nullptr) {
+			break;
+		}
+	}
+
+	return pixels;
+}
 
-	if (size == 0) {
-		fclose(file);
-		throw std::runtime_error("Failed to read image '" + path + "'");
+uint8_t* image::frame_stream::fetch_scaled(int frame, std::vector<constraint>& changes) {
+	if (scaled_ring.empty()) {
+		return fetch(frame, changes);
 	}
 
-	uint8_t* buffer = (uint8_t*)malloc(size);
+	const size_t size = size_t(scaled_width) * scaled_height * RGBA_CHANNELS;
 
-	while (size) {
-		size -= fread(buffer, 1, size, file);
+	for (int i = 0; i < GIF_STREAM_FRAMES; i++) {
+		if (scaled_held[i] == frame) {
+			return scaled_ring.data() + i * size;
+		}
 	}
 
-	fclose(file);
-	return buffer;
+	const uint8_t* pixels = fetch(frame, changes);
+
+	if (pixels == nullptr) {
+		return nullptr;
+	}
+
+	const size_t slot = scaled_count++ % GIF_STREAM_FRAMES;
+	uint8_t* out = scaled_ring.data() + slot * size;
+
+	scale_rgba(pixels, width, height, out, scaled_width, scaled_height);
+	scaled_held[slot] = frame;
+
+	return out;
+}
+
+void image::frame_stream::restart() {
+	STBI_FREE(gif.out);
+	STBI_FREE(gif.background);
+	STBI_FREE(gif.history);
+
+	memset(&gif, 0, sizeof(gif));
+	stbi__start_mem(&context, file->data(), file->size());
+
+	next = 0;
+	ended = false;
 }
 
+// region image
+
 image::image(const std::string& path)
 	: owner(STB), frames(1) {
 
@@ -66,21 +352,49 @@ image::image(const std::string& path)
 	// buffer will always use 4 channels (RGBA)
 	int unused_channel_count = 0;
 
-	// read file into buffer, or throw on error
-	int bytes;
-	uint8_t* buffer = read_file_into_buffer(path, &bytes);
+	// map or read the file, or throw on error
+	std::unique_ptr<file_view> file;
 
-	if (is_gif(buffer, bytes)) {
-		pixels = stbi_load_gif_from_memory(buffer, bytes, nullptr, &w, &h, &frames, &unused_channel_count, RGBA_CHANNELS);
-	} else {
-		pixels = stbi_load_from_memory(buffer, bytes, &w, &h, &unused_channel_count, RGBA_CHANNELS);
+	{
+		stat_timer timer{"read"};
+		file = std::make_unique<file_view>(path);
 	}
 
-	free(buffer);
+	// stb takes the buffer length as an int
+	if (file->size() > INT_MAX) {
+		throw std::runtime_error("Image '" + path + "' is too large");
+	}
+
+	const uint8_t* buffer = file->data();
+	const int bytes = file->size();
+
+	// animations are decoded as they are shown, so the memory used and the time
+	// it takes to show the first frame don't depend on the length of the animation
+	if (const int count = is_gif(buffer, bytes) ? count_gif_frames(buffer, bytes) : 0; count > 1) {
+		stream = std::make_unique<frame_stream>(std::move(file), count);
+
+		if (stream->fetch(0, changes) == nullptr) {
+			throw std::runtime_error("Failed to load image '" + path + "'");
+		}
+
+		w = stream->width;
+		h = stream->height;
+		frames = count;
+		return;
+	}
+
+	stat_timer timer{"decode"};
+	pixels = stbi_load_from_memory(buffer, bytes, &w, &h, &unused_channel_count, RGBA_CHANNELS);
 
 	if (pixels == nullptr) {
 		throw std::runtime_error("Failed to load image '" + path + "'");
 	}
+
+	// a still image never changes
+	changes.assign(1, {});
+
+	// done here, as images are usually loaded while the screen is opened
+	index_spans();
 }
 
 image::image(unsigned char* pixels, int w, int h)
@@ -88,6 +402,101 @@ image::image(unsigned char* pixels, int w, int h)
 
 	this->w = w;
 	this->h = h;
+
+	changes.assign(1, {});
+	index_spans();
+}
+
+void image::resize(int width, int height) {
+	if (width <= 0 || height <= 0) {
+		throw std::runtime_error("Invalid image size " + std::to_string(width) + "x" + std::to_string(height));
+	}
+
+	if (width == w && height == h) {
+		return;
+	}
+
+	if (stream) {
+		stream->scaled_width = width;
+		stream->scaled_height = height;
+		stream->scaled_ring = arena_buffer<uint8_t>(size_t(GIF_STREAM_FRAMES) * width * height * RGBA_CHANNELS);
+
+		for (int& frame : stream->scaled_held) {
+			frame = -1;
+		}
+
+		w = width;
+		h = height;
+		return;
+	}
+
+	arena_buffer<uint8_t> resized(size_t(width) * height * RGBA_CHANNELS);
+	scale_rgba(pixels, w, h, resized.get(), width, height);
+
+	if (owner == STB) {
+		stbi_image_free(pixels);
+		owner = EXTERNAL;
+	}
+
+	scaled = std::move(resized);
+	pixels = scaled.get();
+	w = width;
+	h = height;
+
+	spans = {};
+	span_rows = {};
+	index_spans();
+}
+
+void image::index_spans() {
+	const size_t limit = size_t(w) * h / IMAGE_SPAN_PIXELS;
+	span_rows.reserve(h + 1);
+
+	for (int y = 0; y < h; y++) {
+		const uint8_t* row = pixels + size_t(y) * w * RGBA_CHANNELS;
+		span_rows.push_back(spans.size());
+
+		for (int x = 0; x < w;) {
+			const uint8_t alpha = row[x * RGBA_CHANNELS + 3];
+
+			if (alpha == 0) {
+				x++;
+				continue;
+			}
+
+			const bool opaque = alpha == 255;
+			const int start = x;
+
+			while (x < w && row[x * RGBA_CHANNELS + 3] != 0 && (row[x * RGBA_CHANNELS + 3] == 255) == opaque) {
+				x++;
+			}
+
+			spans.push_back({start, x, opaque});
+		}
+
+		// noisy alpha, going through the runs would be slower than blending everything
+		if (spans.size() > limit) {
+			spans = {};
+			span_rows = {};
+			return;
+		}
+	}
+
+	span_rows.push_back(spans.size());
+}
+
+bool image::has_spans() const {
+	return !span_rows.empty();
+}
+
+std::span<const pixel_span> image::visible_spans(int y) const {
+	return {spans.data() + span_rows.at(y), spans.data() + span_rows.at(y + 1)};
+}
+
+std::future<std::unique_ptr<image>> image::load_async(const std::string& path) {
+	return std::async(std::launch::async, [path] {
+		return std::make_unique<image>(path);
+	});
 }
 
 image::~image() {
@@ -99,7 +508,7 @@ image::~image() {
 }
 
 color image::pixel(int frame, int x, int y) const {
-	return color::from_rgba(pixels + ((frame * h + y) * w + x) * 4);
+	return color::from_rgba(data(frame) + (y * w + x) * 4);
 }
 
 unsigned char* image::data(int frame) const {
@@ -107,9 +516,19 @@ unsigned char* image::data(int frame) const {
 		throw std::runtime_error("Image frame out of range");
 	}
 
+	if (stream) {
+		return stream->fetch_scaled(frame, changes);
+	}
+
 	return pixels + frame * (w * h * 4);
 }
 
+void image::prepare(int frame) const {
+	if (stream) {
+		data(frame);
+	}
+}
+
 void image::dump() const {
 	printf("Image w: %d, h: %d\n", w, h);
 }
@@ -117,3 +536,39 @@ void image::dump() const {
 int image::frame_count() const {
 	return frames;
 }
+
+int image::frame_time(int frame) const {
+	if (file_timing && stream) {
+
+		// delays are only known once the frame was decoded
+		if (frame >= stream->measured) {
+			prepare(frame);
+		}
+
+		if (const int delay = stream->delays.at(frame); delay > 0) {
+			return delay * 1000;
+		}
+	}
+
+	return mspt;
+}
+
+constraint image::damage(int frame) const {
+
+	// the frame count was changed (e.g. animations were
+	// disabled), so the change list no longer applies
+	if (changes.size() != size_t(frames)) {
+		return {0, 0, w, h};
+	}
+
+	// the changes are recorded as frames get decoded
+	if (stream && frame >= stream->measured) {
+		prepare(frame);
+	}
+
+	if (stream && !stream->scaled_ring.empty()) {
+		return scale_region(changes.at(frame), stream->width, stream->height, w, h);
+	}
+
+	return changes.at(frame);
+}
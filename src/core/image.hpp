@@ -13,11 +13,23 @@
 // limitations under the License.
 
 #pragma once
+#include <future>
+#include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
+#include "arena.hpp"
 #include "color.hpp"
 #include "viewport.hpp"
 
+// Run of visible pixels in an image row, either all fully opaque or all partially transparent
+struct pixel_span {
+	int start;
+	int end;
+	bool opaque;
+};
+
 class image : public viewport {
 
 	enum ownership {
@@ -25,22 +37,80 @@ class image : public viewport {
 		EXTERNAL
 	};
 
+	// Decodes animation frames on demand, see image.cpp
+	struct frame_stream;
+
 	ownership owner = EXTERNAL;
 	unsigned char* pixels = nullptr;
 
+	// animations are not decoded up front, only a few frames are kept at once
+	std::unique_ptr<frame_stream> stream;
+
+	// per-frame regions that differ from the previous frame
+	mutable std::vector<constraint> changes;
+
+	// visible runs of pixels of all rows, and the index
+	// of the first run of each row, only for still images
+	std::vector<pixel_span> spans;
+	std::vector<uint32_t> span_rows;
+
+	// pixels of a still image after it was resized
+	arena_buffer<uint8_t> scaled;
+
+	// Find the visible runs of each row, unless there are so many that it wouldn't help
+	void index_spans();
+
 public:
 
 	bool blend = false;
+	bool cache = false;
+
+	// keep cached frames only as the pixels that changed since the previous one
+	bool compress = false;
+
+	bool overlay = false;
 	int frames = 1;
 	int mspt = 41'666;
 	int loops = 1;
 
+	// use the frame delays stored in the file, mspt is then only used for
+	// frames that don't specify one, unset to show every frame for mspt
+	bool file_timing = true;
+
 	image(const std::string& path);
 	image(unsigned char* pixels, int w, int h);
 	~image();
 
+	// Start loading the image on a worker thread, so it can be decoded while
+	// the screen is being set up, get() rethrows any error from loading
+	static std::future<std::unique_ptr<image>> load_async(const std::string& path);
+
 	color pixel(int frame, int x, int y) const;
+	// Get RGBA pixels of a frame, for animations the pointer is only valid
+	// until a few other frames are requested, as those reuse its memory
 	unsigned char* data(int frame) const;
+
+	// Get the frame ready ahead of time, so that data() returns without decoding
+	void prepare(int frame) const;
+
 	void dump() const;
 	int frame_count() const;
+
+	// Scale the image to the given size, still images are scaled right away,
+	// animation frames are scaled as they are decoded
+	void resize(int width, int height);
+
+	// Check if the visible runs of pixels are known, see visible_spans()
+	bool has_spans() const;
+
+	// Runs of visible pixels in the given row, in order, pixels outside of them are fully
+	// transparent, only available for still images, found once when the image is created
+	std::span<const pixel_span> visible_spans(int y) const;
+
+	// Time in microseconds for which the frame should be shown
+	int frame_time(int frame) const;
+
+	// Region, in image coordinates, in which the frame differs from the one
+	// shown before it (for the first frame that is the last one)
+	constraint damage(int frame) const;
 };
@@ -0,0 +1,158 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstring>
+
+#include "blitter.hpp"
+
+// Scalar building blocks shared by the blitter implementations,
+// the vectorized kernels must produce bit-identical results
+
+// Divide by 255 with rounding, exact for all x in [0, 255 * 255]
+static constexpr uint32_t div255_round(uint32_t x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+// Divide by 255 rounding down, exact for all x in [0, 255 * 255]
+static constexpr uint32_t div255_floor(uint32_t x) {
+	return (x + 1 + (x >> 8)) >> 8;
+}
+
+// Blend front over back, as in "a * f + (255 - a) * b"
+static YAV_FORCE_INLINE void blend_pixel(color& front, const color& back) {
+	const uint32_t foreground = front.a;
+	const uint32_t background = 255 - foreground;
+
+	// the results are the same, but fully opaque and fully
+	// transparent pixels are common enough to skip the arithmetic
+	if (foreground == 255) {
+		return;
+	}
+
+	if (foreground == 0) {
+		front.r = back.r;
+		front.g = back.g;
+		front.b = back.b;
+		return;
+	}
+
+	front.r = div255_round(front.r * foreground + back.r * background);
+	front.g = div255_round(front.g * foreground + back.g * background);
+	front.b = div255_round(front.b * foreground + back.b * background);
+}
+
+// Compile-time counterpart of the channel struct, produces
+// exactly the same values as channel::encode and channel::decode
+template <unsigned Length, unsigned Offset>
+struct fixed_channel {
+
+	static constexpr unsigned length = Length;
+	static constexpr unsigned offset = Offset;
+	static constexpr uint32_t mask = (1u << Length) - 1;
+
+	static constexpr uint32_t encode(uint8_t value) {
+		if constexpr (Length == 8) {
+			return uint32_t(value) << Offset;
+		}
+
+		return div255_floor(value * mask) << Offset;
+	}
+
+	static constexpr uint8_t decode(uint32_t pixel) {
+		if constexpr (Length == 8) {
+			return (pixel >> Offset) & mask;
+		}
+
+		return (((pixel >> Offset) & mask) * 255) / mask;
+	}
+};
+
+template <unsigned Bits, typename R, typename G, typename B, typename A>
+struct fixed_kernel {
+
+	static constexpr size_t bytes = Bits / 8;
+	static constexpr uint32_t alpha = A::encode(0xff);
+
+	static YAV_FORCE_INLINE void store(uint8_t* dst, uint32_t pixel) {
+		memcpy(dst, &pixel, bytes);
+	}
+
+	static YAV_FORCE_INLINE uint32_t load(const uint8_t* src) {
+		uint32_t pixel = 0;
+		memcpy(&pixel, src, bytes);
+		return pixel;
+	}
+
+	static YAV_FORCE_INLINE uint32_t encode(uint8_t r, uint8_t g, uint8_t b) {
+		return R::encode(r) | G::encode(g) | B::encode(b) | alpha;
+	}
+
+	static YAV_FORCE_INLINE color decode(uint32_t pixel) {
+		color c;
+		c.r = R::decode(pixel);
+		c.g = G::decode(pixel);
+		c.b = B::decode(pixel);
+		return c;
+	}
+
+	static format layout() {
+		return {Bits, {R::length, R::offset}, {G::length, G::offset}, {B::length, B::offset}, {A::length, A::offset}};
+	}
+
+	static void copy(const format&, uint8_t* dst, const uint8_t* src, int count) {
+		for (int i = 0; i < count; i++) {
+			const uint8_t* pixel = src + i * 4;
+			store(dst + i * bytes, encode(pixel[0], pixel[1], pixel[2]));
+		}
+	}
+
+	static void blend(const format&, uint8_t* dst, const uint8_t* src, const color* back, int count) {
+		for (int i = 0; i < count; i++) {
+			color front = color::from_rgba(src + i * 4);
+			blend_pixel(front, back[i]);
+			store(dst + i * bytes, encode(front.r, front.g, front.b));
+		}
+	}
+
+	static void read(const format&, color* dst, const uint8_t* src, int count) {
+		for (int i = 0; i < count; i++) {
+			dst[i] = decode(load(src + i * bytes));
+		}
+	}
+
+	static void fill(const format&, uint8_t* dst, color c, int count) {
+		if (c.a == 255) {
+			const uint32_t encoded = encode(c.r, c.g, c.b);
+
+			for (int i = 0; i < count; i++) {
+				store(dst + i * bytes, encoded);
+			}
+
+			return;
+		}
+
+		for (int i = 0; i < count; i++) {
+			color front = c;
+			blend_pixel(front, decode(load(dst + i * bytes)));
+			store(dst + i * bytes, encode(front.r, front.g, front.b));
+		}
+	}
+};
+
+template <unsigned Bits, unsigned RL, unsigned RO, unsigned GL, unsigned GO, unsigned BL, unsigned BO, unsigned AL = 0, unsigned AO = 0>
+using fixed = fixed_kernel<Bits, fixed_channel<RL, RO>, fixed_channel<GL, GO>, fixed_channel<BL, BO>, fixed_channel<AL, AO>>;
+
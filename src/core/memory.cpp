@@ -0,0 +1,162 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "memory.hpp"
+
+#include <cstdio>
+#include <stdexcept>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include "blitter.hpp"
+
+static bool has_extension(const std::string& path, const std::string& extension) {
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// region memory_screen
+
+memory_screen::memory_screen(int width, int height, format fmt, int pitch)
+	: m_width(width), m_height(height), m_pitch(pitch), m_format(fmt) {
+
+	const int packed = width * int(fmt.bytes());
+
+	if (width <= 0 || height <= 0) {
+		throw std::runtime_error("Invalid memory screen size " + std::to_string(width) + "x" + std::to_string(height));
+	}
+
+	if (m_pitch == 0) {
+		m_pitch = packed;
+	}
+
+	if (m_pitch < packed) {
+		throw std::runtime_error("Memory screen pitch of " + std::to_string(m_pitch) + " bytes can't fit a row of " + std::to_string(packed) + " bytes");
+	}
+
+	m_buffer.resize(size_t(m_pitch) * height);
+}
+
+format memory_screen::named_format(const std::string& name) {
+	if (name == "xrgb8888") {
+		return {32, {8, 16}, {8, 8}, {8, 0}, {}};
+	}
+
+	if (name == "argb8888") {
+		return {32, {8, 16}, {8, 8}, {8, 0}, {8, 24}};
+	}
+
+	if (name == "xbgr8888") {
+		return {32, {8, 0}, {8, 8}, {8, 16}, {}};
+	}
+
+	if (name == "bgr888") {
+		return {24, {8, 16}, {8, 8}, {8, 0}, {}};
+	}
+
+	if (name == "rgb565") {
+		return {16, {5, 11}, {6, 5}, {5, 0}, {}};
+	}
+
+	throw std::runtime_error("Unknown format '" + name + "' (expected 'xrgb8888', 'argb8888', 'xbgr8888', 'bgr888' or 'rgb565')");
+}
+
+const uint8_t* memory_screen::pixels() const {
+	return m_buffer.data();
+}
+
+void memory_screen::save(const std::string& path) const {
+	const bool png = has_extension(path, ".png");
+
+	if (!png && !has_extension(path, ".ppm")) {
+		FILE* file = fopen(path.c_str(), "wb");
+
+		if (file == nullptr) {
+			throw std::runtime_error("Failed to open '" + path + "' for writing");
+		}
+
+		const size_t written = fwrite(m_buffer.data(), 1, m_buffer.size(), file);
+
+		if (fclose(file) != 0 || written != m_buffer.size()) {
+			throw std::runtime_error("Failed to write '" + path + "'");
+		}
+
+		return;
+	}
+
+	const blitter& kernels = blitter::pick(m_format);
+	std::vector<color> row(m_width);
+	std::vector<uint8_t> rgb(size_t(m_width) * m_height * 3);
+
+	for (int y = 0; y < m_height; y++) {
+		kernels.read(m_format, row.data(), m_buffer.data() + size_t(y) * m_pitch, m_width);
+
+		for (int x = 0; x < m_width; x++) {
+			uint8_t* pixel = rgb.data() + (size_t(y) * m_width + x) * 3;
+			pixel[0] = row[x].r;
+			pixel[1] = row[x].g;
+			pixel[2] = row[x].b;
+		}
+	}
+
+	if (png) {
+		if (stbi_write_png(path.c_str(), m_width, m_height, 3, rgb.data(), m_width * 3) == 0) {
+			throw std::runtime_error("Failed to write '" + path + "'");
+		}
+
+		return;
+	}
+
+	FILE* file = fopen(path.c_str(), "wb");
+
+	if (file == nullptr) {
+		throw std::runtime_error("Failed to open '" + path + "' for writing");
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", m_width, m_height);
+	const size_t written = fwrite(rgb.data(), 1, rgb.size(), file);
+
+	if (fclose(file) != 0 || written != rgb.size()) {
+		throw std::runtime_error("Failed to write '" + path + "'");
+	}
+}
+
+void* memory_screen::data() const {
+	return const_cast<uint8_t*>(m_buffer.data());
+}
+
+void memory_screen::dump() {
+	printf("Memory screen: %dx%d, pitch: %d bytes\n", m_width, m_height, m_pitch);
+	m_format.dump();
+}
+
+int memory_screen::width() const {
+	return m_width;
+}
+
+int memory_screen::height() const {
+	return m_height;
+}
+
+int memory_screen::line_length() const {
+	return m_pitch;
+}
+
+format memory_screen::form() const {
+	return m_format;
+}
+
+void memory_screen::flush() const {
+}
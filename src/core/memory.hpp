@@ -0,0 +1,61 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "format.hpp"
+#include "screen.hpp"
+
+// Screen backed by system memory, for testing, benchmarking and rendering
+// images ahead of time, the contents can be saved into a file
+class memory_screen : public screen {
+
+	int m_width;
+	int m_height;
+	int m_pitch;
+	format m_format;
+	std::vector<uint8_t> m_buffer;
+
+protected:
+
+	void* data() const override;
+
+public:
+
+	// Create a cleared screen, pitch is the line length in bytes,
+	// 0 uses the smallest one that fits a row of the given format
+	memory_screen(int width, int height, format fmt, int pitch = 0);
+
+	// Get one of the common formats by name (e.g. 'xrgb8888', 'rgb565'), or throw if unknown
+	static format named_format(const std::string& name);
+
+	// Contents of the screen, line_length() bytes per row in the screen format
+	const uint8_t* pixels() const;
+
+	// Save the contents into a file, '.png' and '.ppm' files are converted
+	// to RGB, anything else gets the raw bytes in the screen format, ready
+	// to be copied as-is into a device using the same format and pitch
+	void save(const std::string& path) const;
+
+	void dump() override;
+	int width() const override;
+	int height() const override;
+	int line_length() const override;
+	format form() const override;
+	void flush() const override;
+};
@@ -0,0 +1,93 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "pool.hpp"
+
+// region thread_pool
+
+thread_pool::thread_pool(int threads) {
+	for (int i = 1; i < threads; i++) {
+		m_workers.emplace_back(&thread_pool::work, this);
+	}
+}
+
+thread_pool::~thread_pool() {
+	{
+		std::lock_guard lock{m_mutex};
+		m_stopping = true;
+	}
+
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void thread_pool::process(std::unique_lock<std::mutex>& lock) {
+	while (m_next < m_tasks) {
+		const int task = m_next++;
+
+		lock.unlock();
+		(*m_job)(task);
+		lock.lock();
+
+		if (--m_remaining == 0) {
+			m_done.notify_all();
+		}
+	}
+}
+
+void thread_pool::work() {
+	std::unique_lock lock{m_mutex};
+	size_t seen = 0;
+
+	while (true) {
+		m_wake.wait(lock, [&] { return m_stopping || m_generation != seen; });
+
+		if (m_stopping) {
+			return;
+		}
+
+		seen = m_generation;
+		process(lock);
+	}
+}
+
+int thread_pool::size() const {
+	return m_workers.size() + 1;
+}
+
+void thread_pool::run(int tasks, const std::function<void(int)>& job) {
+	std::unique_lock lock{m_mutex};
+
+	// only one job runs at a time, others (e.g. from a thread drawing while another converts frames) wait for it
+	m_done.wait(lock, [&] { return m_job == nullptr; });
+
+	m_job = &job;
+	m_tasks = tasks;
+	m_next = 0;
+	m_remaining = tasks;
+	m_generation++;
+
+	m_wake.notify_all();
+
+	process(lock);
+	m_done.wait(lock, [&] { return m_remaining == 0; });
+
+	m_job = nullptr;
+	m_tasks = 0;
+	m_done.notify_all();
+}
@@ -0,0 +1,61 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that split numbered tasks between them,
+// the calling thread also takes tasks while waiting for them to finish
+class thread_pool {
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	const std::function<void(int)>* m_job = nullptr;
+	size_t m_generation = 0;
+	int m_tasks = 0;
+	int m_next = 0;
+	int m_remaining = 0;
+	bool m_stopping = false;
+
+	// Take tasks of the current job until there are none
+	// left, the lock is released while the tasks run
+	void process(std::unique_lock<std::mutex>& lock);
+
+	void work();
+
+public:
+
+	// Create a pool using the given number of threads, including the calling one
+	thread_pool(int threads);
+	~thread_pool();
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	// Number of threads, including the calling one
+	int size() const;
+
+	// Call job with each task index in [0, tasks), returns once all of them finished, can be
+	// called from multiple threads, but not from within a job, jobs then run one after another
+	void run(int tasks, const std::function<void(int)>& job);
+};
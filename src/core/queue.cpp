@@ -0,0 +1,93 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "queue.hpp"
+
+#include <algorithm>
+
+// region frame_queue
+
+frame_queue::frame_queue(int capacity, int width, int height, size_t bytes)
+	: m_capacity(std::max(capacity, 1)), m_height(std::max(height, 0)), m_pitch(std::max(width, 0) * bytes) {
+
+	m_buffer = arena_buffer<uint8_t>(m_pitch * m_height * m_capacity);
+	m_slots.resize(m_capacity);
+
+	for (int i = 0; i < m_capacity; i++) {
+		m_slots[i].pixels = m_buffer.data() + i * m_pitch * m_height;
+	}
+}
+
+void frame_queue::notify() {
+	m_events.fetch_add(1, std::memory_order_release);
+	m_events.notify_all();
+}
+
+queued_frame* frame_queue::acquire() {
+	const uint32_t published = m_published.load(std::memory_order_relaxed);
+
+	while (true) {
+		// read the counter first, so a release that happens after the check wakes the wait
+		const uint32_t events = m_events.load(std::memory_order_acquire);
+
+		if (m_closed.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+
+		if (published - m_released.load(std::memory_order_acquire) < uint32_t(m_capacity)) {
+			return &m_slots[published % m_capacity];
+		}
+
+		m_events.wait(events, std::memory_order_acquire);
+	}
+}
+
+void frame_queue::publish() {
+	m_published.fetch_add(1, std::memory_order_release);
+	notify();
+}
+
+const queued_frame* frame_queue::front() {
+	const uint32_t released = m_released.load(std::memory_order_relaxed);
+
+	while (true) {
+		const uint32_t events = m_events.load(std::memory_order_acquire);
+
+		// frames published before closing are still shown
+		if (m_published.load(std::memory_order_acquire) != released) {
+			return &m_slots[released % m_capacity];
+		}
+
+		if (m_closed.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+
+		m_events.wait(events, std::memory_order_acquire);
+	}
+}
+
+void frame_queue::release() {
+	m_released.fetch_add(1, std::memory_order_release);
+	notify();
+}
+
+void frame_queue::close() {
+	m_closed.store(true, std::memory_order_release);
+	notify();
+}
+
+size_t frame_queue::pitch() const {
+	return m_pitch;
+}
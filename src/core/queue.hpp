@@ -0,0 +1,85 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arena.hpp"
+#include "viewport.hpp"
+
+// Frame converted into a screen format, along with what's needed to show it
+struct queued_frame {
+	uint8_t* pixels;
+	int frame;
+
+	// time in microseconds for which the frame should be shown
+	int duration;
+
+	// region, in image coordinates, in which it differs from the frame before it
+	constraint damage;
+};
+
+// Bounded lock-free ring of converted frames passed from a single producer thread to a single
+// consumer thread, the producer waits while the ring is full, and the consumer while it's empty
+class frame_queue {
+
+	int m_capacity;
+	int m_height;
+	size_t m_pitch;
+
+	arena_buffer<uint8_t> m_buffer;
+	std::vector<queued_frame> m_slots;
+
+	// number of frames ever published and released, each only written by one side
+	std::atomic<uint32_t> m_published = 0;
+	std::atomic<uint32_t> m_released = 0;
+	std::atomic<bool> m_closed = false;
+
+	// bumped on every change, so that either side can wait for the other
+	std::atomic<uint32_t> m_events = 0;
+
+	void notify();
+
+public:
+
+	frame_queue(int capacity, int width, int height, size_t bytes);
+
+	frame_queue(const frame_queue&) = delete;
+	frame_queue& operator=(const frame_queue&) = delete;
+
+	// Producer: get the next slot to write, waiting for one to be released
+	// if all of them are in use, returns nullptr once the queue was closed
+	queued_frame* acquire();
+
+	// Producer: pass the slot returned by acquire() to the consumer
+	void publish();
+
+	// Consumer: get the oldest published frame, waiting for one if there are
+	// none, returns nullptr once the queue was closed and all frames were taken
+	const queued_frame* front();
+
+	// Consumer: give the slot returned by front() back to the producer
+	void release();
+
+	// Make both sides stop waiting, can be called from either of them
+	void close();
+
+	// Line length, in bytes, of each frame
+	size_t pitch() const;
+};
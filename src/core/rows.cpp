@@ -0,0 +1,176 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "rows.hpp"
+
+#include <cctype>
+#include <cstring>
+
+// region helpers
+
+static uint32_t read_le(const uint8_t* data, int bytes) {
+	uint32_t value = 0;
+
+	for (int i = bytes - 1; i >= 0; i--) {
+		value = (value << 8) | data[i];
+	}
+
+	return value;
+}
+
+// region row_decoder
+
+row_decoder::row_decoder(std::unique_ptr<file_view> file)
+	: m_file(std::move(file)) {}
+
+std::unique_ptr<row_decoder> row_decoder::open(const std::string& path) {
+	std::unique_ptr<row_decoder> decoder{new row_decoder(std::make_unique<file_view>(path))};
+
+	if (!decoder->parse_pnm() && !decoder->parse_bmp()) {
+		return nullptr;
+	}
+
+	// the rows have to be within the file, even if it's truncated
+	if (decoder->m_width <= 0 || decoder->m_height <= 0 || decoder->m_offset + decoder->m_pitch * decoder->m_height > decoder->m_file->size()) {
+		return nullptr;
+	}
+
+	return decoder;
+}
+
+bool row_decoder::parse_pnm() {
+	const uint8_t* data = m_file->data();
+	const size_t size = m_file->size();
+
+	if (size < 3 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) {
+		return false;
+	}
+
+	size_t at = 2;
+	long values[3];
+
+	// width, height and maximum value, separated by whitespace and comments
+	for (long& value : values) {
+		while (at < size && (isspace(data[at]) || data[at] == '#')) {
+			if (data[at] == '#') {
+				while (at < size && data[at] != '\n') {
+					at++;
+				}
+			} else {
+				at++;
+			}
+		}
+
+		if (at >= size || !isdigit(data[at])) {
+			return false;
+		}
+
+		value = 0;
+
+		while (at < size && isdigit(data[at])) {
+			value = value * 10 + (data[at++] - '0');
+
+			// far larger than any supported image, and it must not overflow
+			if (value >= 1'000'000) {
+				return false;
+			}
+		}
+	}
+
+	// a single whitespace character separates the header from the pixels,
+	// only 8 bit samples are supported, the rest are left to stb
+	if (values[2] != 255 || at >= size || !isspace(data[at])) {
+		return false;
+	}
+
+	m_layout = data[1] == '5' ? GRAY : RGB;
+	m_width = values[0];
+	m_height = values[1];
+	m_offset = at + 1;
+	m_pitch = size_t(m_width) * (m_layout == GRAY ? 1 : 3);
+
+	return true;
+}
+
+bool row_decoder::parse_bmp() {
+	const uint8_t* data = m_file->data();
+	const size_t size = m_file->size();
+
+	if (size < 54 || data[0] != 'B' || data[1] != 'M' || read_le(data + 14, 4) < 40) {
+		return false;
+	}
+
+	const int bits = read_le(data + 28, 2);
+	const int height = int32_t(read_le(data + 22, 4));
+
+	// only uncompressed true color images, the height can't be negated if it's the smallest integer
+	if (read_le(data + 30, 4) != 0 || (bits != 24 && bits != 32) || height == INT32_MIN) {
+		return false;
+	}
+
+	m_layout = bits == 24 ? BGR : BGRX;
+	m_width = int32_t(read_le(data + 18, 4));
+	m_height = height < 0 ? -height : height;
+	m_offset = read_le(data + 10, 4);
+	m_pitch = (size_t(m_width) * bits + 31) / 32 * 4;
+	m_bottom_up = height > 0;
+
+	return true;
+}
+
+int row_decoder::width() const {
+	return m_width;
+}
+
+int row_decoder::height() const {
+	return m_height;
+}
+
+void row_decoder::decode(int y, int x, int count, uint8_t* rgba) const {
+	const int row = m_bottom_up ? m_height - 1 - y : y;
+	const uint8_t* src = m_file->data() + m_offset + row * m_pitch;
+
+	switch (m_layout) {
+		case GRAY:
+			for (int i = 0; i < count; i++) {
+				memset(rgba + i * 4, src[x + i], 3);
+				rgba[i * 4 + 3] = 255;
+			}
+
+			break;
+
+		case RGB:
+			for (int i = 0; i < count; i++) {
+				memcpy(rgba + i * 4, src + (x + i) * 3, 3);
+				rgba[i * 4 + 3] = 255;
+			}
+
+			break;
+
+		case BGR:
+		case BGRX:
+			const int bytes = m_layout == BGR ? 3 : 4;
+
+			for (int i = 0; i < count; i++) {
+				const uint8_t* pixel = src + (x + i) * bytes;
+				rgba[i * 4] = pixel[2];
+				rgba[i * 4 + 1] = pixel[1];
+				rgba[i * 4 + 2] = pixel[0];
+				rgba[i * 4 + 3] = 255;
+			}
+
+			break;
+	}
+}
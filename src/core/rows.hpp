@@ -0,0 +1,58 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "file.hpp"
+
+// Decodes uncompressed images (binary PPM and PGM, 24 and 32 bit BMP) one row at a
+// time straight from the mapped file, so the whole image is never held in memory
+class row_decoder {
+
+	enum layout {
+		GRAY,
+		RGB,
+		BGR,
+		BGRX
+	};
+
+	std::unique_ptr<file_view> m_file;
+	layout m_layout = RGB;
+	int m_width = 0;
+	int m_height = 0;
+	size_t m_offset = 0;
+	size_t m_pitch = 0;
+	bool m_bottom_up = false;
+
+	row_decoder(std::unique_ptr<file_view> file);
+
+	bool parse_pnm();
+	bool parse_bmp();
+
+public:
+
+	// Open the image if it's in a format that can be decoded by rows, nullptr if it's not
+	static std::unique_ptr<row_decoder> open(const std::string& path);
+
+	int width() const;
+	int height() const;
+
+	// Decode count pixels of the row, starting at column x, into opaque RGBA pixels
+	void decode(int y, int x, int count, uint8_t* rgba) const;
+};
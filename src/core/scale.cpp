@@ -0,0 +1,233 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "scale.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// filter weights are fixed point numbers with this many fractional bits
+#define SCALE_WEIGHT_BITS 14
+
+// region helpers
+
+// Source pixels contributing to each destination pixel along one axis
+struct filter_taps {
+	int taps = 0;
+
+	// index of the first source pixel, `taps` weights per destination pixel
+	std::vector<int> first;
+	std::vector<uint32_t> weights;
+};
+
+static filter_taps build_taps(int src, int dst) {
+	const double scale = double(dst) / src;
+	std::vector<std::vector<double>> spans(dst);
+
+	filter_taps filter;
+	filter.first.resize(dst);
+
+	for (int i = 0; i < dst; i++) {
+		std::vector<double>& span = spans[i];
+
+		if (scale >= 1) {
+
+			// enlarging interpolates the two nearest pixels
+			const double center = std::clamp((i + 0.5) / scale - 0.5, 0.0, src - 1.0);
+			const int left = std::min(int(center), src - 1);
+			const double fraction = center - left;
+
+			filter.first[i] = left;
+			span = left == src - 1 ? std::vector<double>{1} : std::vector<double>{1 - fraction, fraction};
+		} else {
+
+			// shrinking averages all pixels the destination pixel covers
+			const double begin = i / scale;
+			const double end = std::min((i + 1) / scale, double(src));
+
+			filter.first[i] = int(begin);
+
+			for (int x = int(begin); x < end; x++) {
+				span.push_back(std::min(end, x + 1.0) - std::max(begin, double(x)));
+			}
+		}
+
+		filter.taps = std::max<int>(filter.taps, span.size());
+	}
+
+	filter.weights.resize(size_t(dst) * filter.taps);
+
+	for (int i = 0; i < dst; i++) {
+		const std::vector<double>& span = spans[i];
+
+		double sum = 0;
+
+		for (double weight : span) {
+			sum += weight;
+		}
+
+		// the fixed point weights have to add up to exactly one
+		uint32_t* weights = filter.weights.data() + size_t(i) * filter.taps;
+		uint32_t total = 0;
+
+		for (size_t t = 0; t < span.size(); t++) {
+			weights[t] = std::lround(span[t] / sum * (1 << SCALE_WEIGHT_BITS));
+			total += weights[t];
+		}
+
+		const size_t heaviest = std::max_element(span.begin(), span.end()) - span.begin();
+		weights[heaviest] += (1 << SCALE_WEIGHT_BITS) - total;
+
+		// unused taps have zero weight, but are still read, so
+		// near the edge the weights are moved to keep them within the image
+		if (const int overflow = filter.first[i] + filter.taps - src; overflow > 0) {
+			std::copy_backward(weights, weights + filter.taps - overflow, weights + filter.taps);
+			std::fill(weights, weights + overflow, 0);
+			filter.first[i] -= overflow;
+		}
+	}
+
+	return filter;
+}
+
+// Repeat every pixel the given number of times in both directions
+static void replicate(const uint8_t* src, int sw, int sh, uint8_t* dst, int fx, int fy) {
+	const size_t pitch = size_t(sw) * fx * 4;
+
+	for (int y = 0; y < sh; y++) {
+		uint8_t* row = dst + y * fy * pitch;
+
+		for (int x = 0; x < sw; x++) {
+			for (int i = 0; i < fx; i++) {
+				memcpy(row + (size_t(x) * fx + i) * 4, src + (size_t(y) * sw + x) * 4, 4);
+			}
+		}
+
+		for (int i = 1; i < fy; i++) {
+			memcpy(row + i * pitch, row, pitch);
+		}
+	}
+}
+
+// region scale
+
+void scale_rgba(const uint8_t* src, int sw, int sh, uint8_t* dst, int dw, int dh) {
+	if (sw == dw && sh == dh) {
+		memcpy(dst, src, size_t(sw) * sh * 4);
+		return;
+	}
+
+	if (dw % sw == 0 && dh % sh == 0) {
+		replicate(src, sw, sh, dst, dw / sw, dh / sh);
+		return;
+	}
+
+	const filter_taps columns = build_taps(sw, dw);
+	const filter_taps rows = build_taps(sh, dh);
+
+	const uint32_t round = 1 << (SCALE_WEIGHT_BITS - 1);
+
+	// colors are multiplied by alpha, and alpha by 255, so all channels have the same range
+	std::vector<uint16_t> premultiplied(size_t(sw) * sh * 4);
+
+	for (size_t i = 0; i < size_t(sw) * sh; i++) {
+		const uint8_t* pixel = src + i * 4;
+		uint16_t* out = premultiplied.data() + i * 4;
+
+		out[0] = pixel[0] * pixel[3];
+		out[1] = pixel[1] * pixel[3];
+		out[2] = pixel[2] * pixel[3];
+		out[3] = pixel[3] * 255;
+	}
+
+	// horizontal pass, every source row is scaled to the destination width
+	std::vector<uint16_t> wide(size_t(dw) * sh * 4);
+
+	for (int y = 0; y < sh; y++) {
+		const uint16_t* row = premultiplied.data() + size_t(y) * sw * 4;
+		uint16_t* out = wide.data() + size_t(y) * dw * 4;
+
+		for (int x = 0; x < dw; x++) {
+			const uint16_t* first = row + columns.first[x] * 4;
+			const uint32_t* weights = columns.weights.data() + size_t(x) * columns.taps;
+			uint32_t sum[4] = {round, round, round, round};
+
+			for (int t = 0; t < columns.taps; t++) {
+				for (int c = 0; c < 4; c++) {
+					sum[c] += weights[t] * first[t * 4 + c];
+				}
+			}
+
+			for (int c = 0; c < 4; c++) {
+				out[x * 4 + c] = sum[c] >> SCALE_WEIGHT_BITS;
+			}
+		}
+	}
+
+	// vertical pass, and dividing the colors by alpha again
+	std::vector<uint32_t> sums(size_t(dw) * 4);
+
+	for (int y = 0; y < dh; y++) {
+		const uint32_t* weights = rows.weights.data() + size_t(y) * rows.taps;
+		std::fill(sums.begin(), sums.end(), round);
+
+		for (int t = 0; t < rows.taps; t++) {
+			const uint16_t* row = wide.data() + size_t(rows.first[y] + t) * dw * 4;
+
+			for (int i = 0; i < dw * 4; i++) {
+				sums[i] += weights[t] * row[i];
+			}
+		}
+
+		uint8_t* out = dst + size_t(y) * dw * 4;
+
+		for (int x = 0; x < dw; x++) {
+			const uint32_t* sum = sums.data() + x * 4;
+			const uint32_t alpha = sum[3] >> SCALE_WEIGHT_BITS;
+
+			if (alpha == 0) {
+				memset(out + x * 4, 0, 4);
+				continue;
+			}
+
+			for (int c = 0; c < 3; c++) {
+				out[x * 4 + c] = std::min<uint32_t>(255, ((sum[c] >> SCALE_WEIGHT_BITS) * 255 + alpha / 2) / alpha);
+			}
+
+			out[x * 4 + 3] = (alpha + 127) / 255;
+		}
+	}
+}
+
+constraint scale_region(constraint region, int sw, int sh, int dw, int dh) {
+	if (region.empty()) {
+		return {};
+	}
+
+	// filtering reaches one source pixel past the region
+	const auto map = [](int value, int from, int to, bool up) {
+		const long scaled = long(std::clamp(value, 0, from)) * to;
+		return int(up ? (scaled + from - 1) / from : scaled / from);
+	};
+
+	const int left = map(region.min.x - 1, sw, dw, false);
+	const int top = map(region.min.y - 1, sh, dh, false);
+	const int right = map(region.max.x + 1, sw, dw, true);
+	const int bottom = map(region.max.y + 1, sh, dh, true);
+
+	return {left, top, right - left, bottom - top};
+}
@@ -0,0 +1,29 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <cstdint>
+
+#include "viewport.hpp"
+
+// Resample RGBA pixels to the given size, integer multiples of the size are scaled
+// by repeating pixels, anything else is filtered (bilinear when enlarging, box when
+// shrinking) weighting colors by their alpha, so transparent pixels don't darken edges
+void scale_rgba(const uint8_t* src, int sw, int sh, uint8_t* dst, int dw, int dh);
+
+// Map a region of pixels of the source size onto the destination size, growing it
+// to include every destination pixel that scaling could have changed
+constraint scale_region(constraint region, int sw, int sh, int dw, int dh);
@@ -14,69 +14,323 @@
 
 #include "screen.hpp"
 
+#include <algorithm>
 #include <cstring>
+#include <exception>
 #include <memory>
-#include <unistd.h>
+#include <thread>
+#include <utility>
 
+#include "blitter.hpp"
+#include "clock.hpp"
+#include "config.hpp"
 #include "interrupt.hpp"
-
-#ifdef __GNUC__
-#define YAV_FORCE_INLINE __attribute__((always_inline)) inline
-#else
-#define YAV_FORCE_INLINE inline
-#endif
+#include "logger.hpp"
+#include "queue.hpp"
+#include "stats.hpp"
 
 static YAV_FORCE_INLINE size_t get_offset(const position& offset, int x, int y, size_t stride, size_t bytes) {
 	return (offset.y + y) * stride + (offset.x + x) * bytes;
 }
 
-static YAV_FORCE_INLINE void blend(color& front, const color& back) {
-	const float foreground = front.a / 255.0f;
-	const float background = 1 - foreground;
-
-	front.r = front.r * foreground + back.r * background;
-	front.g = front.g * foreground + back.g * background;
-	front.b = front.b * foreground + back.b * background;
-}
-
-static YAV_FORCE_INLINE void blend(color& s, const void* backbuffer_pixel, const format& fmt, const size_t bytes) {
-	size_t pixel = 0;
-	memcpy(&pixel, backbuffer_pixel, bytes);
-
-	color back;
-	fmt.decode_rgb(pixel, &back.r, &back.g, &back.b);
+// Call back with the visible runs of an image row, clipped to the columns [first, first + count),
+// the callback gets the column of the run relative to the first one, its length and opacity
+template <typename F>
+static void for_each_span(const image& img, int row, int first, int count, F callback) {
+	for (const pixel_span& span : img.visible_spans(row)) {
+		const int start = std::max(span.start, first);
+		const int end = std::min(span.end, first + count);
 
-	blend(s, back);
+		if (start < end) {
+			callback(start - first, end - start, span.opaque);
+		}
+	}
 }
 
 // region screen
 
-color* screen::fetch_backbuffer(constraint region, position offset) {
+arena_buffer<color> screen::fetch_backbuffer(constraint region, position offset, const image* visible, position io) {
 	const int rw = region.width();
 	const int rh = region.height();
 
-	color* backbuffer = new color[rw * rh];
+	arena_buffer<color> backbuffer(size_t(rw) * rh);
+	seed({offset.x, offset.y, rw, rh});
 
 	const format fmt = form();
+	const blitter& kernels = blitter::pick(fmt);
 	const int stride = line_length();
 
 	const size_t bytes = std::min(fmt.bytes(), 8UL);
-	auto* src_buffer = reinterpret_cast<unsigned char*>(data());
+	const uint8_t* src_buffer = canvas();
 
-	for (int y = 0; y < rh; y++) {
-		for (int x = 0; x < rw; x++) {
-			color* dst = backbuffer + (x + y * rw);
-			void* src = src_buffer + get_offset(offset, x, y, stride, bytes);
+	for_each_band(rh, rw, [&](int first, int last) {
+		for (int y = first; y < last; y++) {
+			const uint8_t* src = src_buffer + get_offset(offset, 0, y, stride, bytes);
 
-			size_t pixel = 0;
-			memcpy(&pixel, src, bytes);
-			fmt.decode_rgb(pixel, &dst->r, &dst->g, &dst->b);
+			if (!visible) {
+				kernels.read(fmt, backbuffer.data() + y * rw, src, rw);
+				continue;
+			}
+
+			// opaque runs cover the background, transparent pixels don't touch it
+			for_each_span(*visible, io.y + y, io.x, rw, [&](int x, int count, bool opaque) {
+				if (!opaque) {
+					kernels.read(fmt, backbuffer.data() + y * rw + x, src + x * bytes, count);
+				}
+			});
 		}
-	}
+	});
 
 	return backbuffer;
 }
 
+constraint screen::get_placement(const viewport& area, position& so, position& io) const {
+	constraint scrc{0, 0, width(), height()};
+	constraint view = get_viewport(scrc);
+
+	position placed = area.get_position(view);
+	constraint areac{placed.x, placed.y, area.width(), area.height()};
+
+	constraint region = get_constraint_intersection({scrc, areac, view});
+	so = scrc.offset(region);
+	io = areac.offset(region);
+
+	return region;
+}
+
+void screen::for_each_band(int rows, int columns, const std::function<void(int, int)>& band) const {
+	const int bands = pool ? std::min<long>(pool->size(), long(rows) * columns / SCREEN_BAND_PIXELS) : 1;
+
+	if (bands <= 1) {
+		band(0, rows);
+		return;
+	}
+
+	pool->run(bands, [&](int task) {
+		band(rows * task / bands, rows * (task + 1) / bands);
+	});
+}
+
+void screen::set_threads(int threads) {
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+
+	if (threads <= 1) {
+		pool.reset();
+		return;
+	}
+
+	pool = std::make_unique<thread_pool>(threads);
+}
+
+void screen::set_shadow(bool enabled) {
+	if (!enabled) {
+		shadow = {};
+		return;
+	}
+
+	// other than under blended images in batches, this is the only time the device is read from
+	const size_t size = size_t(line_length()) * height();
+	const auto* device = reinterpret_cast<const uint8_t*>(data());
+
+	shadow = arena_buffer<uint8_t>(size);
+	memcpy(shadow.data(), device, size);
+}
+
+void screen::commit() const {
+	if (batch_depth) {
+		return;
+	}
+
+	stat_timer timer{"flush"};
+	flush();
+}
+
+void screen::show_batch() {
+	const int depth = std::exchange(batch_depth, 0);
+
+	// overlapping layers are only copied once
+	for (const constraint& region : merge_overlapping(std::move(batched))) {
+		present(region);
+	}
+
+	batched.clear();
+	commit();
+	batch_depth = depth;
+}
+
+void screen::begin_batch() {
+	if (batch_depth++) {
+		return;
+	}
+
+	// the batch is composed in the shadow copy, so it has to be enabled for it, but
+	// without reading the device, opaque images and clears are never blended with it
+	batch_shadow = shadow.empty();
+
+	if (batch_shadow) {
+		shadow = arena_buffer<uint8_t>(size_t(line_length()) * height());
+		seeded.clear();
+	}
+
+	batched.clear();
+}
+
+void screen::end_batch() {
+	if (batch_depth == 0 || --batch_depth) {
+		return;
+	}
+
+	show_batch();
+
+	if (batch_shadow) {
+		set_shadow(false);
+		seeded.clear();
+		batch_shadow = false;
+	}
+}
+
+void screen::seed(constraint area) {
+	if (!batch_shadow) {
+		return;
+	}
+
+	const int stride = line_length();
+	const size_t bytes = std::min(form().bytes(), 8UL);
+	const auto* device = reinterpret_cast<const uint8_t*>(data());
+
+	for (const constraint& part : get_constraint_difference(area, seeded)) {
+		const size_t offset = part.min.y * stride + part.min.x * bytes;
+
+		for (int y = 0; y < part.height(); y++) {
+			memcpy(shadow.data() + offset + y * stride, device + offset + y * stride, part.width() * bytes);
+		}
+
+		seeded.push_back(part);
+	}
+}
+
+const uint8_t* screen::shadow_data() const {
+
+	// a shadow copy enabled just for a batch only holds the parts drawn in it
+	return shadow.empty() || batch_shadow ? nullptr : shadow.data();
+}
+
+uint8_t* screen::canvas() {
+	return shadow.empty() ? reinterpret_cast<uint8_t*>(data()) : shadow.data();
+}
+
+void screen::present(constraint region) {
+
+	// whatever was drawn into a batch shadow now holds valid pixels, animations redraw the same area over and over
+	if (batch_shadow && !get_constraint_difference(region, seeded).empty()) {
+		seeded.push_back(region);
+	}
+
+	// batched drawing is only copied into the screen once the batch ends
+	if (batch_depth) {
+		batched.push_back(region);
+		return;
+	}
+
+	if (!shadow.empty()) {
+		const int stride = line_length();
+		const size_t bytes = std::min(form().bytes(), 8UL);
+
+		auto* device = reinterpret_cast<uint8_t*>(data());
+		const size_t offset = region.min.y * stride + region.min.x * bytes;
+		const size_t length = region.width() * bytes;
+
+		for_each_band(region.height(), region.width(), [&](int first, int last) {
+			for (int y = first; y < last; y++) {
+				memcpy(device + offset + y * stride, shadow.data() + offset + y * stride, length);
+			}
+		});
+	}
+
+	invalidate(region);
+}
+
+void screen::invalidate(constraint region) {
+	(void)region;
+}
+
+bool screen::overlay_frame(const image& img, int frame, constraint source, constraint target) {
+	(void)img;
+	(void)frame;
+	(void)source;
+	(void)target;
+
+	return false;
+}
+
+void screen::hide_overlay() {
+}
+
+bool screen::scanout_dmabuf(int fd, int width, int height, int pitch, constraint source, constraint target) {
+	(void)fd;
+	(void)width;
+	(void)height;
+	(void)pitch;
+	(void)source;
+	(void)target;
+
+	return false;
+}
+
+bool screen::show_dmabuf(int fd, const viewport& placement, int pitch) {
+	position so, bo;
+	constraint region = get_placement(placement, so, bo);
+
+	if (region.empty()) {
+		return false;
+	}
+
+	return scanout_dmabuf(fd, placement.width(), placement.height(), pitch, {bo.x, bo.y, region.width(), region.height()}, {so.x, so.y, region.width(), region.height()});
+}
+
+void screen::blit_rows(const row_decoder& rows, const viewport& placement) {
+	position so, io;
+	const constraint region = get_placement(placement, so, io);
+
+	if (region.empty()) {
+		return;
+	}
+
+	const int stride = line_length();
+	const format fmt = form();
+	const blitter& kernels = blitter::pick(fmt);
+	const size_t bytes = std::min(fmt.bytes(), 8UL);
+	const int rw = region.width();
+
+	hide_overlay();
+
+	{
+		stat_timer timer{"blit"};
+
+		uint8_t* dst_buffer = canvas() + get_offset(so, 0, 0, stride, bytes);
+
+		// each band converts through its own single row buffer
+		for_each_band(region.height(), rw, [&](int first, int last) {
+			std::unique_ptr<uint8_t[]> row{new uint8_t[rw * 4]};
+
+			for (int y = first; y < last; y++) {
+				rows.decode(io.y + y, io.x, rw, row.get());
+				kernels.copy(fmt, dst_buffer + y * stride, row.get(), rw);
+			}
+		});
+
+		present({so.x, so.y, rw, region.height()});
+	}
+
+	commit();
+}
+
+constraint screen::get_view_area() const {
+	return get_viewport({0, 0, width(), height()});
+}
+
 constraint screen::get_viewport(constraint scrc) const {
 	viewport sized = view;
 
@@ -91,71 +345,256 @@ constraint screen::get_viewport(constraint scrc) const {
 	return sized.get_constraint(scrc);
 }
 
-void screen::blit_frame(const image& img, int frame, constraint region, position so, position io, color* backbuffer) {
+void screen::render_frame(const image& img, int frame, constraint region, position io, uint8_t* dst, size_t pitch, const color* backbuffer, int back_stride) const {
 
 	const int rw = region.width();
 	const int rh = region.height();
 
-	const int stride = line_length();
 	const format fmt = form();
+	const blitter& kernels = blitter::pick(fmt);
 
-	// save a few cycles by encoding alpha only once
-	const size_t alpha = fmt.encode_alpha(0xff);
-	const size_t bytes = std::min(fmt.bytes(), 8UL);
+	const int src_pitch = img.width() * 4;
+	const auto* src_buffer = img.data(frame) + io.y * src_pitch + io.x * 4;
 
-	auto* dst_buffer = reinterpret_cast<unsigned char*>(data());
-
-	for (int y = 0; y < rh; y++) {
-		for (int x = 0; x < rw; x++) {
-			void* dst = dst_buffer + get_offset(so, x, y, stride, bytes);
-			color src = img.pixel(frame, io.x + x, io.y + y);
+	for_each_band(rh, rw, [&](int first, int last) {
+		for (int y = first; y < last; y++) {
+			uint8_t* dst_row = dst + y * pitch;
+			const uint8_t* src_row = src_buffer + y * src_pitch;
 
 			if (backbuffer) {
-				blend(src, backbuffer[x + y * rw]);
+				kernels.blend(fmt, dst_row, src_row, backbuffer + y * back_stride, rw);
+			} else {
+				kernels.copy(fmt, dst_row, src_row, rw);
 			}
+		}
+	});
+}
 
-			const size_t encoded = fmt.encode_rgb(src.r, src.g, src.b) | alpha;
-			memcpy(dst, &encoded, bytes);
+void screen::render_spans(const image& img, constraint region, position io, uint8_t* dst, size_t pitch, const color* backbuffer, int back_stride) const {
+	const format fmt = form();
+	const blitter& kernels = blitter::pick(fmt);
+	const size_t bytes = std::min(fmt.bytes(), 8UL);
+
+	const int rw = region.width();
+	const int src_pitch = img.width() * 4;
+	const auto* src_buffer = img.data(0) + io.y * src_pitch + io.x * 4;
+
+	for_each_band(region.height(), rw, [&](int first, int last) {
+		for (int y = first; y < last; y++) {
+			uint8_t* dst_row = dst + y * pitch;
+			const uint8_t* src_row = src_buffer + y * src_pitch;
+
+			for_each_span(img, io.y + y, io.x, rw, [&](int x, int count, bool opaque) {
+				if (opaque) {
+					kernels.copy(fmt, dst_row + x * bytes, src_row + x * 4, count);
+				} else {
+					kernels.blend(fmt, dst_row + x * bytes, src_row + x * 4, backbuffer + y * back_stride + x, count);
+				}
+			});
 		}
+	});
+}
+
+void screen::blit_frame(const image& img, int frame, constraint region, constraint dirty, position so, position io, const color* backbuffer, bool background) {
+	const int stride = line_length();
+	const size_t bytes = std::min(form().bytes(), 8UL);
+
+	// move all offsets to the top left corner of the dirty area
+	const position to{so.x + dirty.min.x, so.y + dirty.min.y};
+	const position from{io.x + dirty.min.x, io.y + dirty.min.y};
+
+	if (backbuffer) {
+		backbuffer += dirty.min.y * region.width() + dirty.min.x;
 	}
 
-	flush();
+	{
+		stat_timer timer{"blit"};
+
+		uint8_t* dst_buffer = canvas();
+
+		if (background && backbuffer && img.has_spans()) {
+			render_spans(img, dirty, from, dst_buffer + get_offset(to, 0, 0, stride, bytes), stride, backbuffer, region.width());
+		} else {
+			render_frame(img, frame, dirty, from, dst_buffer + get_offset(to, 0, 0, stride, bytes), stride, backbuffer, region.width());
+		}
+
+		present({to.x, to.y, dirty.width(), dirty.height()});
+	}
+
+	commit();
+}
+
+void screen::blit_cached(const uint8_t* pixels, size_t pitch, constraint dirty, position so) {
+	const int stride = line_length();
+	const size_t bytes = std::min(form().bytes(), 8UL);
+
+	{
+		stat_timer timer{"blit"};
+
+		uint8_t* dst_buffer = canvas();
+		const uint8_t* src_buffer = pixels + dirty.min.y * pitch + dirty.min.x * bytes;
+
+		for (int y = 0; y < dirty.height(); y++) {
+			memcpy(dst_buffer + get_offset(so, dirty.min.x, dirty.min.y + y, stride, bytes), src_buffer + y * pitch, dirty.width() * bytes);
+		}
+
+		present({so.x + dirty.min.x, so.y + dirty.min.y, dirty.width(), dirty.height()});
+	}
+
+	commit();
 }
 
 void screen::blit(const image& img) {
 	int count = img.loops;
 
+	// there is no point composing frames that are never seen
+	if (batch_depth && img.frame_count() > 1) {
+		show_batch();
+
+		const int depth = std::exchange(batch_depth, 0);
+		blit(img);
+		batch_depth = depth;
+		return;
+	}
+
 	// calculate final image offset
-	constraint scrc{0, 0, width(), height()};
-	constraint view = get_viewport(scrc);
+	position so, io;
+	constraint region = get_placement(img, so, io);
 
-	position placed = img.get_position(view);
-	constraint imgc{placed.x, placed.y, img.width(), img.height()};
+	arena_buffer<color> backbuffer;
+	bool overlay = img.overlay;
 
-	constraint region = get_constraint_intersection({scrc, imgc, view});
-	position so = scrc.offset(region);
-	position io = imgc.offset(region);
+	// after the first frame is drawn into the screen, only the
+	// parts that differ from the previous frame are redrawn
+	bool drawn = false;
+	const constraint whole{0, 0, region.width(), region.height()};
 
-	std::unique_ptr<color[]> backbuffer;
+	// the background is only read once, so each frame always converts to the same
+	// pixels, caching them only makes sense if they will be shown more than once
+	std::unique_ptr<frame_cache> cache;
 
-	if (img.blend) {
-		backbuffer.reset(fetch_backbuffer(region, so));
+	if (img.cache && img.compress && img.loops != 1 && img.frame_count() > 1 && !overlay) {
+		if (img.blend) {
+			backbuffer = fetch_backbuffer(region, so);
+		}
+
+		blit_deltas(img, region, so, io, backbuffer.get());
+		return;
+	}
+
+	if (img.cache && img.loops != 1) {
+		cache = std::make_unique<frame_cache>(region.width(), region.height(), img.frame_count(), std::min(form().bytes(), 8UL));
+	}
+
+	// animations drawn into the screen are decoded along the way, on another thread
+	if (img.frame_count() > 1 && !overlay && !cache) {
+		if (img.blend) {
+			backbuffer = fetch_backbuffer(region, so);
+		}
+
+		blit_queued(img, region, so, io, backbuffer.get());
+		return;
 	}
 
+	// frames are scheduled against absolute deadlines, as
+	// due unshown frames are dropped, the animation keeps its pace
+	frame_clock clock;
+
+	// union of damage of the frames that were dropped since the last drawn one
+	constraint skipped{};
+
 	while (count) {
 		auto last = img.frame_count() - 1;
 
 		for (int frame = 0; frame <= last; frame++) {
-			blit_frame(img, frame, region, so, io, backbuffer.get());
+			const int duration = img.frame_time(frame);
+			const long lag = clock.lag();
+
+			// after a long stall (e.g. the process was stopped) catching
+			// up would only drop frames, so start counting from now instead
+			if (lag > SCREEN_MAX_LAG_US) {
+				clock.restart();
+			} else if (drawn && frame != last && lag >= duration) {
+
+				// the frame would be due to be replaced before it is shown, the last
+				// frame is never dropped, so each loop ends showing the same image
+				skipped = get_constraint_union({skipped, img.damage(frame)});
+				clock.advance(duration);
+				continue;
+			}
 
-			if (was_interrupted()) {
+			if (overlay && !overlay_frame(img, frame, {io.x, io.y, region.width(), region.height()}, {so.x, so.y, region.width(), region.height()})) {
+				LOG_WARN("Hardware overlay unavailable, drawing the image into the screen!\n");
+				overlay = false;
+			}
+
+			// whatever was shown on the plane before would cover the image
+			if (!overlay && !drawn) {
+				hide_overlay();
+			}
+
+			// the overlay plane does its own blending, so the
+			// background is only needed when drawing into the screen
+			if (!overlay) {
+				// a still image is drawn just once, so only the background under its
+				// partially transparent pixels is needed, unless it's also cached
+				if (img.blend && !backbuffer) {
+					const bool spans = img.has_spans() && !cache && !drawn;
+					backbuffer = fetch_backbuffer(region, so, spans ? &img : nullptr, io);
+				}
+
+				constraint dirty = whole;
+
+				// damage is in image coordinates, move it into the region
+				if (drawn) {
+					const constraint changed = get_constraint_union({skipped, img.damage(frame)});
+					dirty = get_constraint_intersection({whole, {changed.min.x - io.x, changed.min.y - io.y, changed.width(), changed.height()}});
+				}
+
+				if (cache && !cache->is_ready(frame)) {
+					stat_timer timer{"convert"};
+					render_frame(img, frame, region, io, cache->data(frame), cache->pitch(), backbuffer.get(), region.width());
+					cache->set_ready(frame);
+				}
+
+				// nothing visible changed, keep showing the previous frame
+				if (!dirty.empty()) {
+					if (cache) {
+						blit_cached(cache->data(frame), cache->pitch(), dirty, so);
+					} else {
+						blit_frame(img, frame, region, dirty, so, io, backbuffer.get(), !drawn);
+					}
+				}
+
+				drawn = true;
+			} else {
+				drawn = false;
+			}
+
+			skipped = {};
+
+			if (was_interrupted() || cancel) {
 				return;
 			}
 
-			// only sleep if there will be another frame
-			if (frame != last) {
-				usleep(img.mspt);
+			// nothing follows the very last frame
+			if (frame == last && count == 1) {
+				break;
+			}
+
+			// decode the next frame while this one is shown, that way
+			// the time it takes is hidden in the delay between frames
+			const int upcoming = frame == last ? 0 : frame + 1;
+
+			if (!(cache && cache->is_ready(upcoming))) {
+				img.prepare(upcoming);
 			}
+
+			// the time spent drawing (which includes waiting for vblank on page
+			// flipping screens) counts towards the frame time, the last frame
+			// is also shown for its full time before the animation loops
+			clock.advance(duration);
+			clock.wait();
 		}
 
 		// setting loop to -1 puts it into an infinite loop
@@ -165,16 +604,305 @@ void screen::blit(const image& img) {
 	}
 }
 
+void screen::blit_queued(const image& img, constraint region, position so, position io, const color* backbuffer) {
+	const constraint whole{0, 0, region.width(), region.height()};
+	const int last = img.frame_count() - 1;
+
+	frame_queue queue{SCREEN_QUEUE_FRAMES, region.width(), region.height(), std::min(form().bytes(), 8UL)};
+	std::exception_ptr error;
+
+	// the producer only ever touches the image, the consumer only the queued
+	// frames, it pushes them in the same order in which they are shown
+	std::thread producer{[&] {
+		try {
+			int count = img.loops;
+
+			while (count) {
+				for (int frame = 0; frame <= last; frame++) {
+					queued_frame* slot = queue.acquire();
+
+					if (!slot) {
+						return;
+					}
+
+					{
+						stat_timer timer{"convert"};
+						render_frame(img, frame, region, io, slot->pixels, queue.pitch(), backbuffer, region.width());
+					}
+
+					slot->frame = frame;
+					slot->duration = img.frame_time(frame);
+					slot->damage = img.damage(frame);
+					queue.publish();
+				}
+
+				if (count > 0) {
+					count--;
+				}
+			}
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		queue.close();
+	}};
+
+	const auto stop = [&]() {
+		queue.close();
+		producer.join();
+	};
+
+	try {
+		frame_clock clock;
+		constraint skipped{};
+		bool drawn = false;
+		int count = img.loops;
+
+		hide_overlay();
+
+		while (const queued_frame* next = queue.front()) {
+			const int frame = next->frame;
+			const int duration = next->duration;
+			const long lag = clock.lag();
+
+			const bool final = frame == last && count == 1;
+
+			if (frame == last && count > 0) {
+				count--;
+			}
+
+			// same pacing as blit(), late frames are dropped, except the last one of each loop
+			if (lag > SCREEN_MAX_LAG_US) {
+				clock.restart();
+			} else if (drawn && frame != last && lag >= duration) {
+				skipped = get_constraint_union({skipped, next->damage});
+				queue.release();
+				clock.advance(duration);
+				continue;
+			}
+
+			constraint dirty = whole;
+
+			if (drawn) {
+				const constraint changed = get_constraint_union({skipped, next->damage});
+				dirty = get_constraint_intersection({whole, {changed.min.x - io.x, changed.min.y - io.y, changed.width(), changed.height()}});
+			}
+
+			if (!dirty.empty()) {
+				blit_cached(next->pixels, queue.pitch(), dirty, so);
+			}
+
+			queue.release();
+			drawn = true;
+			skipped = {};
+
+			if (was_interrupted() || cancel || final) {
+				break;
+			}
+
+			clock.advance(duration);
+			clock.wait();
+		}
+	} catch (...) {
+		stop();
+		throw;
+	}
+
+	stop();
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+void screen::blit_deltas(const image& img, constraint region, position so, position io, const color* backbuffer) {
+	const int last = img.frame_count() - 1;
+	const size_t bytes = std::min(form().bytes(), 8UL);
+	const size_t stride = line_length();
+
+	delta_frames deltas{region.width(), region.height(), img.frame_count(), bytes};
+	frame_clock clock;
+	constraint skipped{};
+	bool drawn = false;
+	int count = img.loops;
+
+	hide_overlay();
+
+	while (count) {
+		for (int frame = 0; frame <= last; frame++) {
+			const int duration = img.frame_time(frame);
+			const long lag = clock.lag();
+
+			// same pacing as blit(), except that dropped frames still have to be stored or
+			// applied, as each one is only known by how it differs from the one before it
+			const bool dropped = lag <= SCREEN_MAX_LAG_US && drawn && frame != last && lag >= duration;
+
+			if (lag > SCREEN_MAX_LAG_US) {
+				clock.restart();
+			}
+
+			// the first loop shows the frames as they are converted, later ones write
+			// the runs over the previous frame, which is still shown on the screen
+			const bool replay = deltas.is_ready(frame);
+			constraint changed;
+
+			if (replay) {
+				stat_timer timer{"blit"};
+				changed = deltas.apply(frame, canvas() + get_offset(so, 0, 0, stride, bytes), stride);
+			} else {
+				stat_timer timer{"convert"};
+				render_frame(img, frame, region, io, deltas.scratch(), deltas.pitch(), backbuffer, region.width());
+				changed = deltas.set_ready(frame);
+			}
+
+			const constraint dirty = get_constraint_union({skipped, changed});
+
+			// nothing visible changed, keep showing the previous frame
+			if (!dropped && !dirty.empty()) {
+				if (replay) {
+					present({so.x + dirty.min.x, so.y + dirty.min.y, dirty.width(), dirty.height()});
+					commit();
+				} else {
+					blit_cached(deltas.latest(), deltas.pitch(), dirty, so);
+				}
+			}
+
+			// the last frame is never dropped, after it's shown only the runs are needed
+			if (!replay && frame == last) {
+				deltas.release_latest();
+			}
+
+			if (dropped) {
+				skipped = get_constraint_union({skipped, changed});
+				clock.advance(duration);
+				continue;
+			}
+
+			drawn = true;
+			skipped = {};
+
+			if (was_interrupted() || cancel) {
+				return;
+			}
+
+			if (frame == last && count == 1) {
+				break;
+			}
+
+			const int upcoming = frame == last ? 0 : frame + 1;
+
+			if (!deltas.is_ready(upcoming)) {
+				img.prepare(upcoming);
+			}
+
+			clock.advance(duration);
+			clock.wait();
+		}
+
+		if (count > 0) {
+			count--;
+		}
+	}
+}
+
+void screen::save_splash(const image& img, const std::string& path, uint64_t key) {
+	position so, io;
+	constraint region = get_placement(img, so, io);
+
+	if (region.empty()) {
+		throw std::runtime_error("Image doesn't cover any part of the viewport, there is nothing to save");
+	}
+
+	arena_buffer<color> backbuffer;
+
+	if (img.blend) {
+		backbuffer = fetch_backbuffer(region, so);
+	}
+
+	const constraint whole{0, 0, region.width(), region.height()};
+	frame_cache frames{region.width(), region.height(), img.frame_count(), std::min(form().bytes(), 8UL)};
+
+	std::vector<int> times;
+	std::vector<constraint> damage;
+
+	for (int frame = 0; frame < img.frame_count(); frame++) {
+		render_frame(img, frame, region, io, frames.data(frame), frames.pitch(), backbuffer.get(), region.width());
+
+		const constraint changed = img.damage(frame);
+		damage.push_back(get_constraint_intersection({whole, {changed.min.x - io.x, changed.min.y - io.y, changed.width(), changed.height()}}));
+		times.push_back(img.frame_time(frame));
+	}
+
+	splash_file::write(path, key, {form(), width(), height(), line_length()}, so, img.loops, frames, times, damage);
+}
+
+bool screen::blit_splash(const splash_file& splash) {
+	if (!splash.matches({form(), width(), height(), line_length()})) {
+		return false;
+	}
+
+	if (batch_depth && splash.frame_count() > 1) {
+		show_batch();
+
+		const int depth = std::exchange(batch_depth, 0);
+		blit_splash(splash);
+		batch_depth = depth;
+		return true;
+	}
+
+	const constraint region = splash.region();
+	const constraint whole{0, 0, region.width(), region.height()};
+	const position so = region.min;
+
+	frame_clock clock;
+	int count = splash.loop_count();
+	bool drawn = false;
+
+	hide_overlay();
+
+	while (count) {
+		const int last = splash.frame_count() - 1;
+
+		for (int frame = 0; frame <= last; frame++) {
+			const constraint dirty = drawn ? get_constraint_intersection({whole, splash.damage(frame)}) : whole;
+
+			if (!dirty.empty()) {
+				blit_cached(splash.data(frame), splash.pitch(), dirty, so);
+			}
+
+			drawn = true;
+
+			if (was_interrupted() || cancel) {
+				return true;
+			}
+
+			if (frame == last && count == 1) {
+				break;
+			}
+
+			clock.advance(splash.frame_time(frame));
+			clock.wait();
+		}
+
+		// setting loop to -1 puts it into an infinite loop
+		if (count > 0) {
+			count--;
+		}
+	}
+
+	return true;
+}
+
 void screen::clear(color c) {
 	const int w = width();
 	const int h = height();
 	const int stride = line_length();
 
 	const format fmt = form();
+	const blitter& kernels = blitter::pick(fmt);
 	const size_t bytes = std::min(fmt.bytes(), 8UL);
-	const size_t alpha = fmt.encode_alpha(0xff);
 
-	auto* dst = reinterpret_cast<uint8_t*>(data());
+	uint8_t* dst = canvas();
 
 	if (c.a == 0) {
 		return;
@@ -186,17 +914,17 @@ void screen::clear(color c) {
 	constraint region = get_constraint_intersection({scrc, view});
 	position so = scrc.offset(region);
 
-	for (int y = 0; y < region.height(); y++) {
-		for (int x = 0; x < region.width(); x++) {
-			void* target = dst + get_offset(so, x, y, stride, bytes);
-			color src = c;
-
-			if (src.a != 255) {
-				blend(src, target, fmt, bytes);
-			}
+	// a translucent color is blended with what the screen shows
+	if (c.a != 255) {
+		seed({so.x, so.y, region.width(), region.height()});
+	}
 
-			const size_t encoded = fmt.encode_rgb(src.r, src.g, src.b) | alpha;
-			memcpy(target, &encoded, bytes);
+	for_each_band(region.height(), region.width(), [&](int first, int last) {
+		for (int y = first; y < last; y++) {
+			kernels.fill(fmt, dst + get_offset(so, 0, y, stride, bytes), c, region.width());
 		}
-	}
+	});
+
+	present({so.x, so.y, region.width(), region.height()});
+	commit();
 }
@@ -14,24 +14,114 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "arena.hpp"
+#include "cache.hpp"
 #include "color.hpp"
 #include "format.hpp"
 #include "image.hpp"
+#include "pool.hpp"
+#include "rows.hpp"
+#include "splash.hpp"
 #include "viewport.hpp"
 
 class screen {
 
 private:
 
-	color* fetch_backbuffer(constraint region, position offset);
+	std::unique_ptr<thread_pool> pool;
+
+	// copy of the screen contents in system memory, empty if disabled
+	arena_buffer<uint8_t> shadow;
+
+	// Read the region of the screen at the offset, if an image (placed at io within the region) with
+	// a span index is given, only pixels under its partially transparent runs are read, leaving the
+	// rest of the returned buffer uninitialized
+	arena_buffer<color> fetch_backbuffer(constraint region, position offset, const image* visible = nullptr, position io = {});
+
+	// Get the region of the screen covered by the area placed within the viewport, along
+	// with the offsets of that region into the screen (so) and into the area (io)
+	constraint get_placement(const viewport& area, position& so, position& io) const;
+
+	// Show an animation with frames decoded and converted on another thread, a few frames ahead
+	// of the one being shown, so that slow frames don't stall it as long as the average keeps up
+	void blit_queued(const image& img, constraint region, position so, position io, const color* backbuffer);
+
+	// Show a cached animation with frames stored as runs of pixels changed since the previous one,
+	// the first loop converts every frame, later ones write the runs straight into the screen
+	void blit_deltas(const image& img, constraint region, position so, position io, const color* backbuffer);
+
+	// number of nested batches, the regions drawn since the outermost one
+	// started and whether the shadow copy was enabled just for it
+	int batch_depth = 0;
+	bool batch_shadow = false;
+	std::vector<constraint> batched;
+
+	// parts of a shadow copy enabled for a batch that hold what the screen shows, the rest is uninitialized
+	std::vector<constraint> seeded;
+
+	// Make the area of a shadow copy enabled for a batch hold what the screen shows, before it's
+	// read, only the parts nothing was drawn into during the batch are read from the device
+	void seed(constraint area);
+
+	// Flush the screen, unless drawing is batched
+	void commit() const;
+
+	// Copy the regions drawn so far in the batch into the screen and flush it, the batch goes on
+	void show_batch();
+
+	// Get the buffer to draw into, either the shadow copy or data()
+	uint8_t* canvas();
+
+	// Copy the region from the shadow copy (if used) into data() and invalidate it
+	void present(constraint region);
+
+	// Split the rows into horizontal bands, drawn in parallel if threads are enabled,
+	// the callback gets the first row of the band and the one just after it
+	void for_each_band(int rows, int columns, const std::function<void(int, int)>& band) const;
 
 protected:
 
 	// Pointer to the start of underlying data, in screen-specific format
 	virtual void* data() const = 0;
 
-	// Write image into the screen
-	void blit_frame(const image& img, int frame, constraint region, position so, position io, color* backbuffer);
+	// Called after the given region of data() was modified, before the
+	// next flush, screens can use it to limit the work done while flushing
+	virtual void invalidate(constraint region);
+
+	// Show the source rectangle of an image frame at the target rectangle of the screen
+	// using a hardware plane, without touching data(), returns false if unsupported
+	virtual bool overlay_frame(const image& img, int frame, constraint source, constraint target);
+
+	// Stop showing anything on the hardware plane used by overlay_frame()
+	virtual void hide_overlay();
+
+	// Scan out the source rectangle of a dmabuf holding RGBA pixels at the target
+	// rectangle of the screen, without copying it, returns false if unsupported
+	virtual bool scanout_dmabuf(int fd, int width, int height, int pitch, constraint source, constraint target);
+
+	// Convert image frame into a buffer using the screen format, the
+	// backbuffer (if given) holds `back_stride` colors per row
+	void render_frame(const image& img, int frame, constraint region, position io, uint8_t* dst, size_t pitch, const color* backbuffer, int back_stride) const;
+
+	// Same as render_frame() for a still image with a span index, only its visible runs
+	// are drawn, the destination must already hold the background under the rest
+	void render_spans(const image& img, constraint region, position io, uint8_t* dst, size_t pitch, const color* backbuffer, int back_stride) const;
+
+	// Write the dirty part (relative to the region) of the image into the screen, if the screen
+	// still shows the background under the region, transparent runs of blended images are skipped
+	void blit_frame(const image& img, int frame, constraint region, constraint dirty, position so, position io, const color* backbuffer, bool background = false);
+
+	// Write the dirty part of a frame already converted into the screen format into the screen
+	void blit_cached(const uint8_t* pixels, size_t pitch, constraint dirty, position so);
+
+	// Get the shadow copy, which holds everything presented so far in
+	// rows of line_length() bytes, or nullptr if there is none
+	const uint8_t* shadow_data() const;
 
 	// Computes the viewport constraint for the given screen
 	constraint get_viewport(constraint scrc) const;
@@ -40,14 +130,49 @@ public:
 
 	viewport view{};
 
+	// Set from any thread to make a running blit return after the current frame
+	std::atomic<bool> cancel = false;
+
 	virtual ~screen() = default;
 
 	// Write image into the screen
 	void blit(const image& img);
 
-	// Clear the screen contents
+	// Clear the screen contents, and flush it unless drawing is batched
 	void clear(color c);
 
+	// Render every frame of the image, as blit() would draw it now, into a splash
+	// file, blended images are blended with what the screen currently shows
+	void save_splash(const image& img, const std::string& path, uint64_t key);
+
+	// Show frames from a splash file, returns false if it was written for a different screen
+	bool blit_splash(const splash_file& splash);
+
+	// Decode the rows of an opaque image straight into the screen at the placement, positioned
+	// like an image would be, only the visible part is decoded and no full copy of it is kept
+	void blit_rows(const row_decoder& rows, const viewport& placement);
+
+	// Get the area of the screen covered by the viewport
+	constraint get_view_area() const;
+
+	// Show a dmabuf holding RGBA pixels of the placement size, positioned
+	// like an image would be, returns false if the screen can't scan it out
+	bool show_dmabuf(int fd, const viewport& placement, int pitch);
+
+	// Compose everything drawn until end_batch() in system memory, and then copy only the drawn regions
+	// into the screen and flush it once, batches can be nested, in which case the outermost one is shown,
+	// animations show what was drawn before them before they play, and batching continues after them
+	void begin_batch();
+	void end_batch();
+
+	// Draw using the given number of threads, 0 uses one per CPU core
+	// and 1 (the default) draws with just the calling thread
+	void set_threads(int threads);
+
+	// Keep a copy of the screen in system memory and only ever write to the device, device
+	// memory is often uncached, which makes reading it back for blending very slow
+	void set_shadow(bool enabled);
+
 	// Print generic information about this screen to the standard output
 	virtual void dump() = 0;
 
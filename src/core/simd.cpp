@@ -0,0 +1,515 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "simd.hpp"
+
+#include "kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define YAV_SIMD_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define YAV_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// Every vectorized kernel processes as many whole vectors as it can
+// and leaves the rest of the row to the scalar kernel it replaces
+
+using XRGB8888 = fixed<32, 8, 16, 8, 8, 8, 0>;
+using ARGB8888 = fixed<32, 8, 16, 8, 8, 8, 0, 8, 24>;
+using XBGR8888 = fixed<32, 8, 0, 8, 8, 8, 16>;
+using ABGR8888 = fixed<32, 8, 0, 8, 8, 8, 16, 8, 24>;
+using RGB565 = fixed<16, 5, 11, 6, 5, 5, 0>;
+
+#if defined(YAV_SIMD_X86)
+
+// region sse4.1
+
+#define YAV_TARGET_SSE __attribute__((target("sse4.1")))
+#define YAV_TARGET_AVX __attribute__((target("avx2")))
+
+struct sse41 {
+
+	// Shuffle mask moving RGBA bytes into place in a 32 bit pixel, with the
+	// top byte cleared, when swapped the red and blue channels are exchanged
+	template <bool Swap>
+	YAV_TARGET_SSE static inline __m128i swizzle_mask() {
+		if constexpr (Swap) {
+			return _mm_setr_epi8(2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128);
+		}
+
+		return _mm_setr_epi8(0, 1, 2, -128, 4, 5, 6, -128, 8, 9, 10, -128, 12, 13, 14, -128);
+	}
+
+	// Shuffle mask moving one channel of four RGBA pixels into 16 bit
+	// lanes, either in the low or the high half of the register
+	YAV_TARGET_SSE static inline __m128i gather_mask(char c, bool high) {
+		const char z = -128;
+
+		if (high) {
+			return _mm_setr_epi8(z, z, z, z, z, z, z, z, c, z, c + 4, z, c + 8, z, c + 12, z);
+		}
+
+		return _mm_setr_epi8(c, z, c + 4, z, c + 8, z, c + 12, z, z, z, z, z, z, z, z, z);
+	}
+
+	// Computes div255_round() of each 16 bit lane
+	YAV_TARGET_SSE static inline __m128i div255_round(__m128i x) {
+		x = _mm_add_epi16(x, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+	}
+
+	// Computes div255_floor() of each 16 bit lane
+	YAV_TARGET_SSE static inline __m128i div255_floor(__m128i x) {
+		const __m128i biased = _mm_add_epi16(x, _mm_set1_epi16(1));
+		return _mm_srli_epi16(_mm_add_epi16(biased, _mm_srli_epi16(x, 8)), 8);
+	}
+
+	// Blend four RGBA pixels over four background colors, the alpha
+	// bytes of the result are undefined
+	YAV_TARGET_SSE static inline __m128i blend(__m128i front, __m128i back) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i full = _mm_set1_epi16(255);
+		const __m128i spread = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+
+		// vectors of only opaque or only transparent pixels skip the arithmetic
+		const int alphas = 0x8888;
+
+		if ((_mm_movemask_epi8(_mm_cmpeq_epi8(front, _mm_set1_epi8(-1))) & alphas) == alphas) {
+			return front;
+		}
+
+		if ((_mm_movemask_epi8(_mm_cmpeq_epi8(front, zero)) & alphas) == alphas) {
+			return back;
+		}
+
+		const __m128i alpha = _mm_shuffle_epi8(front, spread);
+		const __m128i alpha_lo = _mm_unpacklo_epi8(alpha, zero);
+		const __m128i alpha_hi = _mm_unpackhi_epi8(alpha, zero);
+
+		__m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(front, zero), alpha_lo);
+		__m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(front, zero), alpha_hi);
+
+		lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(back, zero), _mm_sub_epi16(full, alpha_lo)));
+		hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(back, zero), _mm_sub_epi16(full, alpha_hi)));
+
+		return _mm_packus_epi16(div255_round(lo), div255_round(hi));
+	}
+
+	// Pack eight RGBA pixels into eight RGB565 pixels
+	YAV_TARGET_SSE static inline __m128i pack565(__m128i first, __m128i second) {
+		__m128i r = _mm_or_si128(_mm_shuffle_epi8(first, gather_mask(0, false)), _mm_shuffle_epi8(second, gather_mask(0, true)));
+		__m128i g = _mm_or_si128(_mm_shuffle_epi8(first, gather_mask(1, false)), _mm_shuffle_epi8(second, gather_mask(1, true)));
+		__m128i b = _mm_or_si128(_mm_shuffle_epi8(first, gather_mask(2, false)), _mm_shuffle_epi8(second, gather_mask(2, true)));
+
+		r = div255_floor(_mm_mullo_epi16(r, _mm_set1_epi16(31)));
+		g = div255_floor(_mm_mullo_epi16(g, _mm_set1_epi16(63)));
+		b = div255_floor(_mm_mullo_epi16(b, _mm_set1_epi16(31)));
+
+		return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b);
+	}
+
+	template <typename Scalar, bool Swap>
+	YAV_TARGET_SSE static void copy32(const format& fmt, uint8_t* dst, const uint8_t* src, int count) {
+		const __m128i mask = swizzle_mask<Swap>();
+		const __m128i alpha = _mm_set1_epi32(Scalar::alpha);
+
+		int i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, mask), alpha));
+		}
+
+		Scalar::copy(fmt, dst + i * 4, src + i * 4, count - i);
+	}
+
+	template <typename Scalar, bool Swap>
+	YAV_TARGET_SSE static void blend32(const format& fmt, uint8_t* dst, const uint8_t* src, const color* back, int count) {
+		const __m128i mask = swizzle_mask<Swap>();
+		const __m128i alpha = _mm_set1_epi32(Scalar::alpha);
+		const auto* bg = reinterpret_cast<const uint8_t*>(back);
+
+		int i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			const __m128i front = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+			const __m128i behind = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + i * 4));
+			const __m128i pixels = blend(front, behind);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, mask), alpha));
+		}
+
+		Scalar::blend(fmt, dst + i * 4, src + i * 4, back + i, count - i);
+	}
+
+	template <typename Scalar>
+	YAV_TARGET_SSE static void copy565(const format& fmt, uint8_t* dst, const uint8_t* src, int count) {
+		int i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+			const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), pack565(first, second));
+		}
+
+		Scalar::copy(fmt, dst + i * 2, src + i * 4, count - i);
+	}
+
+	template <typename Scalar>
+	YAV_TARGET_SSE static void blend565(const format& fmt, uint8_t* dst, const uint8_t* src, const color* back, int count) {
+		const auto* bg = reinterpret_cast<const uint8_t*>(back);
+
+		int i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			const __m128i first = blend(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + i * 4)));
+			const __m128i second = blend(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg + i * 4 + 16)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), pack565(first, second));
+		}
+
+		Scalar::blend(fmt, dst + i * 2, src + i * 4, back + i, count - i);
+	}
+};
+
+// region avx2
+
+struct avx2 {
+
+	// Same as sse41::swizzle_mask, repeated in both 128 bit lanes
+	template <bool Swap>
+	YAV_TARGET_AVX static inline __m256i swizzle_mask() {
+		if constexpr (Swap) {
+			return _mm256_setr_epi8(2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128, 2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128);
+		}
+
+		return _mm256_setr_epi8(0, 1, 2, -128, 4, 5, 6, -128, 8, 9, 10, -128, 12, 13, 14, -128, 0, 1, 2, -128, 4, 5, 6, -128, 8, 9, 10, -128, 12, 13, 14, -128);
+	}
+
+	// Same as sse41::gather_mask, repeated in both 128 bit lanes
+	YAV_TARGET_AVX static inline __m256i gather_mask(char c, bool high) {
+		const char z = -128;
+
+		if (high) {
+			return _mm256_setr_epi8(z, z, z, z, z, z, z, z, c, z, c + 4, z, c + 8, z, c + 12, z, z, z, z, z, z, z, z, z, c, z, c + 4, z, c + 8, z, c + 12, z);
+		}
+
+		return _mm256_setr_epi8(c, z, c + 4, z, c + 8, z, c + 12, z, z, z, z, z, z, z, z, z, c, z, c + 4, z, c + 8, z, c + 12, z, z, z, z, z, z, z, z, z);
+	}
+
+	YAV_TARGET_AVX static inline __m256i div255_round(__m256i x) {
+		x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+		return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+	}
+
+	YAV_TARGET_AVX static inline __m256i div255_floor(__m256i x) {
+		const __m256i biased = _mm256_add_epi16(x, _mm256_set1_epi16(1));
+		return _mm256_srli_epi16(_mm256_add_epi16(biased, _mm256_srli_epi16(x, 8)), 8);
+	}
+
+	// Blend eight RGBA pixels over eight background colors, the alpha
+	// bytes of the result are undefined
+	YAV_TARGET_AVX static inline __m256i blend(__m256i front, __m256i back) {
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i full = _mm256_set1_epi16(255);
+		const __m256i spread = _mm256_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15, 3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+
+		// vectors of only opaque or only transparent pixels skip the arithmetic
+		const uint32_t alphas = 0x88888888;
+
+		if ((uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(front, _mm256_set1_epi8(-1)))) & alphas) == alphas) {
+			return front;
+		}
+
+		if ((uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(front, zero))) & alphas) == alphas) {
+			return back;
+		}
+
+		// unpack and pack operate within 128 bit lanes, so the pixel order is preserved
+		const __m256i alpha = _mm256_shuffle_epi8(front, spread);
+		const __m256i alpha_lo = _mm256_unpacklo_epi8(alpha, zero);
+		const __m256i alpha_hi = _mm256_unpackhi_epi8(alpha, zero);
+
+		__m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(front, zero), alpha_lo);
+		__m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(front, zero), alpha_hi);
+
+		lo = _mm256_add_epi16(lo, _mm256_mullo_epi16(_mm256_unpacklo_epi8(back, zero), _mm256_sub_epi16(full, alpha_lo)));
+		hi = _mm256_add_epi16(hi, _mm256_mullo_epi16(_mm256_unpackhi_epi8(back, zero), _mm256_sub_epi16(full, alpha_hi)));
+
+		return _mm256_packus_epi16(div255_round(lo), div255_round(hi));
+	}
+
+	// Pack sixteen RGBA pixels into sixteen RGB565 pixels
+	YAV_TARGET_AVX static inline __m256i pack565(__m256i first, __m256i second) {
+		__m256i r = _mm256_or_si256(_mm256_shuffle_epi8(first, gather_mask(0, false)), _mm256_shuffle_epi8(second, gather_mask(0, true)));
+		__m256i g = _mm256_or_si256(_mm256_shuffle_epi8(first, gather_mask(1, false)), _mm256_shuffle_epi8(second, gather_mask(1, true)));
+		__m256i b = _mm256_or_si256(_mm256_shuffle_epi8(first, gather_mask(2, false)), _mm256_shuffle_epi8(second, gather_mask(2, true)));
+
+		r = div255_floor(_mm256_mullo_epi16(r, _mm256_set1_epi16(31)));
+		g = div255_floor(_mm256_mullo_epi16(g, _mm256_set1_epi16(63)));
+		b = div255_floor(_mm256_mullo_epi16(b, _mm256_set1_epi16(31)));
+
+		const __m256i packed = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, 11), _mm256_slli_epi16(g, 5)), b);
+
+		// the lanes now hold pixels [0-3, 8-11 | 4-7, 12-15], restore the order
+		return _mm256_permute4x64_epi64(packed, 0xD8);
+	}
+
+	template <typename Scalar, bool Swap>
+	YAV_TARGET_AVX static void copy32(const format& fmt, uint8_t* dst, const uint8_t* src, int count) {
+		const __m256i mask = swizzle_mask<Swap>();
+		const __m256i alpha = _mm256_set1_epi32(Scalar::alpha);
+
+		int i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, mask), alpha));
+		}
+
+		Scalar::copy(fmt, dst + i * 4, src + i * 4, count - i);
+	}
+
+	template <typename Scalar, bool Swap>
+	YAV_TARGET_AVX static void blend32(const format& fmt, uint8_t* dst, const uint8_t* src, const color* back, int count) {
+		const __m256i mask = swizzle_mask<Swap>();
+		const __m256i alpha = _mm256_set1_epi32(Scalar::alpha);
+		const auto* bg = reinterpret_cast<const uint8_t*>(back);
+
+		int i = 0;
+
+		for (; i + 8 <= count; i += 8) {
+			const __m256i front = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+			const __m256i behind = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + i * 4));
+			const __m256i pixels = blend(front, behind);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, mask), alpha));
+		}
+
+		Scalar::blend(fmt, dst + i * 4, src + i * 4, back + i, count - i);
+	}
+
+	template <typename Scalar>
+	YAV_TARGET_AVX static void copy565(const format& fmt, uint8_t* dst, const uint8_t* src, int count) {
+		int i = 0;
+
+		for (; i + 16 <= count; i += 16) {
+			const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+			const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4 + 32));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), pack565(first, second));
+		}
+
+		Scalar::copy(fmt, dst + i * 2, src + i * 4, count - i);
+	}
+
+	template <typename Scalar>
+	YAV_TARGET_AVX static void blend565(const format& fmt, uint8_t* dst, const uint8_t* src, const color* back, int count) {
+		const auto* bg = reinterpret_cast<const uint8_t*>(back);
+
+		int i = 0;
+
+		for (; i + 16 <= count; i += 16) {
+			const __m256i first = blend(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + i * 4)));
+			const __m256i second = blend(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4 + 32)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg + i * 4 + 32)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), pack565(first, second));
+		}
+
+		Scalar::blend(fmt, dst + i * 2, src + i * 4, back + i, count - i);
+	}
+};
+
+#elif defined(YAV_SIMD_NEON)
+
+// region neon
+
+struct neon {
+
+	// Computes div255_round() of each 16 bit lane and narrows the result
+	static inline uint8x8_t div255_round(uint16x8_t x) {
+		x = vaddq_u16(x, vdupq_n_u16(128));
+		return vshrn_n_u16(vsraq_n_u16(x, x, 8), 8);
+	}
+
+	// Computes div255_floor() of each 16 bit lane
+	static inline uint16x8_t div255_floor(uint16x8_t x) {
+		return vshrq_n_u16(vsraq_n_u16(vaddq_u16(x, vdupq_n_u16(1)), x, 8), 8);
+	}
+
+	// Blend a single channel of sixteen pixels
+	static inline uint8x16_t blend(uint8x16_t front, uint8x16_t back, uint8x16_t alpha) {
+		const uint8x16_t inverse = vmvnq_u8(alpha);
+
+		uint16x8_t lo = vmull_u8(vget_low_u8(front), vget_low_u8(alpha));
+		uint16x8_t hi = vmull_u8(vget_high_u8(front), vget_high_u8(alpha));
+
+		lo = vmlal_u8(lo, vget_low_u8(back), vget_low_u8(inverse));
+		hi = vmlal_u8(hi, vget_high_u8(back), vget_high_u8(inverse));
+
+		return vcombine_u8(div255_round(lo), div255_round(hi));
+	}
+
+	// Blend sixteen deinterleaved RGBA pixels over the background, the alpha
+	// channel of the result is undefined
+	static inline uint8x16x4_t blend(uint8x16x4_t front, uint8x16x4_t back) {
+
+		// vectors of only opaque or only transparent pixels skip the arithmetic
+		if (vminvq_u8(front.val[3]) == 255) {
+			return front;
+		}
+
+		if (vmaxvq_u8(front.val[3]) == 0) {
+			return back;
+		}
+
+		front.val[0] = blend(front.val[0], back.val[0], front.val[3]);
+		front.val[1] = blend(front.val[1], back.val[1], front.val[3]);
+		front.val[2] = blend(front.val[2], back.val[2], front.val[3]);
+		return front;
+	}
+
+	// Pack eight pixels worth of channels into RGB565
+	static inline uint16x8_t pack565(uint8x8_t r, uint8x8_t g, uint8x8_t b) {
+		const uint16x8_t r5 = div255_floor(vmull_u8(r, vdup_n_u8(31)));
+		const uint16x8_t g6 = div255_floor(vmull_u8(g, vdup_n_u8(63)));
+		const uint16x8_t b5 = div255_floor(vmull_u8(b, vdup_n_u8(31)));
+
+		return vorrq_u16(vorrq_u16(vshlq_n_u16(r5, 11), vshlq_n_u16(g6, 5)), b5);
+	}
+
+	static inline void store565(uint8_t* dst, const uint8x16x4_t& pixels) {
+		const uint16x8_t lo = pack565(vget_low_u8(pixels.val[0]), vget_low_u8(pixels.val[1]), vget_low_u8(pixels.val[2]));
+		const uint16x8_t hi = pack565(vget_high_u8(pixels.val[0]), vget_high_u8(pixels.val[1]), vget_high_u8(pixels.val[2]));
+
+		vst1q_u8(dst, vreinterpretq_u8_u16(lo));
+		vst1q_u8(dst + 16, vreinterpretq_u8_u16(hi));
+	}
+
+	template <typename Scalar, bool Swap>
+	static inline void store32(uint8_t* dst, const uint8x16x4_t& pixels) {
+		uint8x16x4_t out;
+
+		out.val[0] = pixels.val[Swap ? 2 : 0];
+		out.val[1] = pixels.val[1];
+		out.val[2] = pixels.val[Swap ? 0 : 2];
+		out.val[3] = vdupq_n_u8(Scalar::alpha >> 24);
+
+		vst4q_u8(dst, out);
+	}
+
+	template <typename Scalar, bool Swap>
+	static void copy32(const format& fmt, uint8_t* dst, const uint8_t* src, int count) {
+		int i = 0;
+
+		for (; i + 16 <= count; i += 16) {
+			store32<Scalar, Swap>(dst + i * 4, vld4q_u8(src + i * 4));
+		}
+
+		Scalar::copy(fmt, dst + i * 4, src + i * 4, count - i);
+	}
+
+	template <typename Scalar, bool Swap>
+	static void blend32(const format& fmt, uint8_t* dst, const uint8_t* src, const color* back, int count) {
+		const auto* bg = reinterpret_cast<const uint8_t*>(back);
+
+		int i = 0;
+
+		for (; i + 16 <= count; i += 16) {
+			store32<Scalar, Swap>(dst + i * 4, blend(vld4q_u8(src + i * 4), vld4q_u8(bg + i * 4)));
+		}
+
+		Scalar::blend(fmt, dst + i * 4, src + i * 4, back + i, count - i);
+	}
+
+	template <typename Scalar>
+	static void copy565(const format& fmt, uint8_t* dst, const uint8_t* src, int count) {
+		int i = 0;
+
+		for (; i + 16 <= count; i += 16) {
+			store565(dst + i * 2, vld4q_u8(src + i * 4));
+		}
+
+		Scalar::copy(fmt, dst + i * 2, src + i * 4, count - i);
+	}
+
+	template <typename Scalar>
+	static void blend565(const format& fmt, uint8_t* dst, const uint8_t* src, const color* back, int count) {
+		const auto* bg = reinterpret_cast<const uint8_t*>(back);
+
+		int i = 0;
+
+		for (; i + 16 <= count; i += 16) {
+			store565(dst + i * 2, blend(vld4q_u8(src + i * 4), vld4q_u8(bg + i * 4)));
+		}
+
+		Scalar::blend(fmt, dst + i * 2, src + i * 4, back + i, count - i);
+	}
+};
+
+#endif
+
+// region dispatch
+
+template <typename Backend>
+static void accelerate(const format& fmt, blitter& kernels) {
+	if (fmt == XRGB8888::layout()) {
+		kernels.copy = Backend::template copy32<XRGB8888, true>;
+		kernels.blend = Backend::template blend32<XRGB8888, true>;
+	} else if (fmt == ARGB8888::layout()) {
+		kernels.copy = Backend::template copy32<ARGB8888, true>;
+		kernels.blend = Backend::template blend32<ARGB8888, true>;
+	} else if (fmt == XBGR8888::layout()) {
+		kernels.copy = Backend::template copy32<XBGR8888, false>;
+		kernels.blend = Backend::template blend32<XBGR8888, false>;
+	} else if (fmt == ABGR8888::layout()) {
+		kernels.copy = Backend::template copy32<ABGR8888, false>;
+		kernels.blend = Backend::template blend32<ABGR8888, false>;
+	} else if (fmt == RGB565::layout()) {
+		kernels.copy = Backend::template copy565<RGB565>;
+		kernels.blend = Backend::template blend565<RGB565>;
+	}
+}
+
+const char* simd_instruction_set() {
+#if defined(YAV_SIMD_X86)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		return "avx2";
+	}
+
+	if (__builtin_cpu_supports("sse4.1")) {
+		return "sse4.1";
+	}
+#elif defined(YAV_SIMD_NEON)
+	return "neon";
+#endif
+
+	return "none";
+}
+
+void simd_accelerate(const format& fmt, blitter& kernels) {
+#if defined(YAV_SIMD_X86)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		accelerate<avx2>(fmt, kernels);
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		accelerate<sse41>(fmt, kernels);
+	}
+#elif defined(YAV_SIMD_NEON)
+	accelerate<neon>(fmt, kernels);
+#else
+	(void)fmt;
+	(void)kernels;
+#endif
+}
@@ -0,0 +1,25 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "blitter.hpp"
+
+// Name of the vector instruction set used by the accelerated
+// kernels on this CPU, or "none" if there is no support
+const char* simd_instruction_set();
+
+// Replace the kernels of the given format with vectorized ones, leaves
+// the blitter unchanged if the format or host CPU is not supported
+void simd_accelerate(const format& fmt, blitter& kernels);
@@ -0,0 +1,228 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "splash.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
+
+#define SPLASH_MAGIC "YAVSPLSH"
+#define SPLASH_VERSION 1
+
+// region helpers
+
+struct stored_channel {
+	uint32_t length;
+	uint32_t offset;
+};
+
+static stored_channel store_channel(const channel& ch) {
+	return {ch.length, ch.offset};
+}
+
+static channel load_channel(const stored_channel& ch) {
+	return {ch.length, ch.offset};
+}
+
+// Make a rename in the directory holding the file durable
+static bool sync_directory(const std::string& path) {
+	const std::string parent = std::filesystem::path(path).parent_path().string();
+	const int fd = open(parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY);
+
+	if (fd < 0) {
+		return false;
+	}
+
+	const bool synced = fsync(fd) == 0;
+	close(fd);
+	return synced;
+}
+
+// region splash_file
+
+struct splash_file::header {
+	char magic[8];
+	uint32_t version;
+	uint32_t bits;
+	stored_channel r, g, b, a;
+	uint64_t key;
+
+	// screen the frames were rendered for
+	int32_t screen_width;
+	int32_t screen_height;
+	int32_t line_length;
+
+	// region of the screen covered by the frames, and bytes per row of each frame
+	int32_t x, y, width, height;
+	int32_t pitch;
+
+	int32_t frames;
+	int32_t loops;
+};
+
+struct splash_file::frame_info {
+	int32_t time;
+	int32_t min_x, min_y, max_x, max_y;
+};
+
+splash_file::splash_file(const std::string& path)
+	: m_file(std::make_unique<file_view>(path)) {
+
+	const size_t size = m_file->size();
+
+	if (size < sizeof(header)) {
+		throw std::runtime_error("Splash file '" + path + "' is truncated");
+	}
+
+	m_header = reinterpret_cast<const header*>(m_file->data());
+
+	if (memcmp(m_header->magic, SPLASH_MAGIC, sizeof(m_header->magic)) != 0 || m_header->version != SPLASH_VERSION) {
+		throw std::runtime_error("File '" + path + "' is not a splash file, or was written by a different version");
+	}
+
+	const size_t frames = std::max(m_header->frames, 0);
+	const size_t pixels = sizeof(header) + frames * sizeof(frame_info);
+
+	if (frames == 0 || m_header->width <= 0 || m_header->height <= 0 || m_header->pitch <= 0) {
+		throw std::runtime_error("Splash file '" + path + "' is corrupted");
+	}
+
+	// the sizes come from the file, so a crafted header must not wrap around the size they add up to
+	size_t frame_bytes, total_bytes;
+
+	if (__builtin_mul_overflow(pitch(), size_t(m_header->height), &frame_bytes) || __builtin_mul_overflow(frame_bytes, frames, &total_bytes) || size < pixels || size - pixels < total_bytes) {
+		throw std::runtime_error("Splash file '" + path + "' is truncated");
+	}
+
+	// the region is checked here, so that only the screen size has to be compared later
+	const constraint screen{0, 0, m_header->screen_width, m_header->screen_height};
+	const constraint covered = region();
+	const constraint inside = get_constraint_intersection({screen, covered});
+
+	if (inside.min.x != covered.min.x || inside.min.y != covered.min.y || inside.max.x != covered.max.x || inside.max.y != covered.max.y || size_t(m_header->pitch) < m_header->width * size_t(m_header->bits / 8)) {
+		throw std::runtime_error("Splash file '" + path + "' is corrupted");
+	}
+
+	m_frames = reinterpret_cast<const frame_info*>(m_file->data() + sizeof(header));
+	m_pixels = m_file->data() + pixels;
+}
+
+splash_file::~splash_file() = default;
+
+void splash_file::write(const std::string& path, uint64_t key, const splash_target& target, position offset, int loops, const frame_cache& frames, const std::vector<int>& times, const std::vector<constraint>& damage) {
+	header head{};
+	memcpy(head.magic, SPLASH_MAGIC, sizeof(head.magic));
+
+	head.version = SPLASH_VERSION;
+	head.bits = target.fmt.bits;
+	head.r = store_channel(target.fmt.r);
+	head.g = store_channel(target.fmt.g);
+	head.b = store_channel(target.fmt.b);
+	head.a = store_channel(target.fmt.a);
+	head.key = key;
+	head.screen_width = target.width;
+	head.screen_height = target.height;
+	head.line_length = target.line_length;
+	head.x = offset.x;
+	head.y = offset.y;
+	head.width = frames.width();
+	head.height = frames.height();
+	head.pitch = frames.pitch();
+	head.frames = frames.frame_count();
+	head.loops = loops;
+
+	// written next to the old file and then renamed over it, so that
+	// losing power during a boot never leaves a broken splash behind
+	const std::string temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+
+	if (file == nullptr) {
+		throw std::runtime_error("Failed to open '" + temporary + "' for writing");
+	}
+
+	bool written = fwrite(&head, sizeof(head), 1, file) == 1;
+
+	for (int i = 0; i < head.frames; i++) {
+		const constraint& box = damage.at(i);
+		const frame_info info{times.at(i), box.min.x, box.min.y, box.max.x, box.max.y};
+
+		written = written && fwrite(&info, sizeof(info), 1, file) == 1;
+	}
+
+	const size_t size = frames.pitch() * frames.height();
+
+	for (int i = 0; i < head.frames && size; i++) {
+		written = written && fwrite(frames.data(i), size, 1, file) == 1;
+	}
+
+	// the contents have to reach the disk before the rename does, or it could expose a torn file
+	written = written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+
+	if (fclose(file) != 0 || !written || rename(temporary.c_str(), path.c_str()) != 0) {
+		remove(temporary.c_str());
+		throw std::runtime_error("Failed to write '" + path + "'");
+	}
+
+	if (!sync_directory(path)) {
+		throw std::runtime_error("Failed to sync the directory of '" + path + "'");
+	}
+}
+
+uint64_t splash_file::key() const {
+	return m_header->key;
+}
+
+bool splash_file::matches(const splash_target& target) const {
+	const format stored{m_header->bits, load_channel(m_header->r), load_channel(m_header->g), load_channel(m_header->b), load_channel(m_header->a)};
+
+	return stored == target.fmt && m_header->screen_width == target.width && m_header->screen_height == target.height && m_header->line_length == target.line_length;
+}
+
+constraint splash_file::region() const {
+	return {m_header->x, m_header->y, m_header->width, m_header->height};
+}
+
+int splash_file::frame_count() const {
+	return m_header->frames;
+}
+
+int splash_file::loop_count() const {
+	return m_header->loops;
+}
+
+int splash_file::frame_time(int frame) const {
+	return m_frames[frame].time;
+}
+
+constraint splash_file::damage(int frame) const {
+	const frame_info& info = m_frames[frame];
+	return {info.min_x, info.min_y, info.max_x - info.min_x, info.max_y - info.min_y};
+}
+
+const uint8_t* splash_file::data(int frame) const {
+	if (frame >= m_header->frames) {
+		throw std::runtime_error("Splash frame out of range");
+	}
+
+	return m_pixels + frame * pitch() * m_header->height;
+}
+
+size_t splash_file::pitch() const {
+	return m_header->pitch;
+}
@@ -0,0 +1,82 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cache.hpp"
+#include "file.hpp"
+#include "format.hpp"
+#include "viewport.hpp"
+
+// Layout of the screen a splash file was rendered for
+struct splash_target {
+	format fmt;
+	int width;
+	int height;
+	int line_length;
+};
+
+// Frames already converted into a screen format and placed on the screen, saved
+// into a file so that showing them again only needs copying rows into the screen,
+// the file is only meant to be read on the machine that wrote it
+class splash_file {
+
+	struct header;
+	struct frame_info;
+
+	std::unique_ptr<file_view> m_file;
+	const header* m_header = nullptr;
+	const frame_info* m_frames = nullptr;
+	const uint8_t* m_pixels = nullptr;
+
+public:
+
+	// Map a splash file, throws if it can't be read or is not a valid splash file
+	splash_file(const std::string& path);
+	~splash_file();
+
+	// Save frames rendered for the target, along with the screen region they
+	// cover and, for each frame, its time and region that changed since the
+	// previous one, the key identifies what the splash was rendered from
+	static void write(const std::string& path, uint64_t key, const splash_target& target, position offset, int loops, const frame_cache& frames, const std::vector<int>& times, const std::vector<constraint>& damage);
+
+	// Key given when the file was written
+	uint64_t key() const;
+
+	// Check if the frames can be copied as-is into the given screen
+	bool matches(const splash_target& target) const;
+
+	// Screen region covered by the frames
+	constraint region() const;
+
+	int frame_count() const;
+	int loop_count() const;
+
+	// Time in microseconds for which the frame should be shown
+	int frame_time(int frame) const;
+
+	// Region of the frame, relative to region(), that differs from the previous frame
+	constraint damage(int frame) const;
+
+	// Get pointer to the first row of the given frame
+	const uint8_t* data(int frame) const;
+
+	// Line length, in bytes, of each frame
+	size_t pitch() const;
+};
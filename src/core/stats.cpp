@@ -0,0 +1,114 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+struct stage_samples {
+	const char* name;
+	std::vector<long> samples;
+};
+
+static std::atomic<bool> is_enabled = false;
+static std::mutex samples_mutex;
+static std::vector<stage_samples> stages;
+
+// region stats
+
+void enable_stats() {
+	is_enabled = true;
+}
+
+bool are_stats_enabled() {
+	return is_enabled;
+}
+
+void record_stat(const char* stage, long us) {
+	if (!is_enabled) {
+		return;
+	}
+
+	// images are decoded on another thread, so this can be called concurrently
+	std::lock_guard lock{samples_mutex};
+
+	auto it = std::find_if(stages.begin(), stages.end(), [&](const stage_samples& entry) {
+		return strcmp(entry.name, stage) == 0;
+	});
+
+	if (it == stages.end()) {
+		it = stages.insert(stages.end(), {stage, {}});
+	}
+
+	it->samples.push_back(us);
+}
+
+void print_stats(bool json) {
+	std::lock_guard lock{samples_mutex};
+
+	if (json) {
+		printf("{");
+	} else {
+		printf("%-10s %8s %10s %10s %10s %10s\n", "Stage", "Count", "Min [us]", "Avg [us]", "P99 [us]", "Max [us]");
+	}
+
+	for (size_t i = 0; i < stages.size(); i++) {
+		std::vector<long> sorted = stages[i].samples;
+		std::sort(sorted.begin(), sorted.end());
+
+		long sum = 0;
+
+		for (long sample : sorted) {
+			sum += sample;
+		}
+
+		const size_t count = sorted.size();
+		const long avg = sum / long(count);
+		const long p99 = sorted[std::min(count - 1, count * 99 / 100)];
+
+		if (json) {
+			printf("%s\"%s\":{\"count\":%zu,\"min\":%ld,\"avg\":%ld,\"p99\":%ld,\"max\":%ld}", i ? "," : "", stages[i].name, count, sorted.front(), avg, p99, sorted.back());
+		} else {
+			printf("%-10s %8zu %10ld %10ld %10ld %10ld\n", stages[i].name, count, sorted.front(), avg, p99, sorted.back());
+		}
+	}
+
+	if (json) {
+		printf("}\n");
+	}
+}
+
+// region stat_timer
+
+stat_timer::stat_timer(const char* stage)
+	: m_stage(stage), m_enabled(is_enabled) {
+
+	// don't even read the clock unless the sample will be used
+	if (m_enabled) {
+		m_start = std::chrono::steady_clock::now();
+	}
+}
+
+stat_timer::~stat_timer() {
+	if (m_enabled) {
+		const auto spent = std::chrono::steady_clock::now() - m_start;
+		record_stat(m_stage, std::chrono::duration_cast<std::chrono::microseconds>(spent).count());
+	}
+}
@@ -0,0 +1,45 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+
+#include <chrono>
+
+// Enable collecting timing samples, until then nothing is recorded
+void enable_stats();
+bool are_stats_enabled();
+
+// Add a sample, in microseconds, to the named stage, the name must outlive the stats
+void record_stat(const char* stage, long us);
+
+// Print the minimum, average, 99th percentile and maximum time of each stage,
+// as a table or as a single JSON object, stages are listed in order of first use
+void print_stats(bool json);
+
+// Records the time from its creation to its destruction under the given stage
+class stat_timer {
+
+	const char* m_stage;
+	std::chrono::steady_clock::time_point m_start;
+	bool m_enabled;
+
+public:
+
+	stat_timer(const char* stage);
+	~stat_timer();
+
+	stat_timer(const stat_timer&) = delete;
+	stat_timer& operator=(const stat_timer&) = delete;
+};
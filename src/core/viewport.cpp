@@ -36,6 +36,10 @@ int constraint::height() const {
 	return max.y - min.y;
 }
 
+bool constraint::empty() const {
+	return width() <= 0 || height() <= 0;
+}
+
 position constraint::offset(const constraint& other) const {
 	return {other.min.x - min.x, other.min.y - min.y};
 }
@@ -53,6 +57,93 @@ constraint get_constraint_intersection(std::initializer_list<constraint> boxes)
 	return inter;
 }
 
+constraint get_constraint_union(std::initializer_list<constraint> boxes) {
+	constraint uni;
+	bool first = true;
+
+	for (auto& box : boxes) {
+		if (box.empty()) {
+			continue;
+		}
+
+		if (first) {
+			uni = box;
+			first = false;
+			continue;
+		}
+
+		uni.min.x = std::min(uni.min.x, box.min.x);
+		uni.min.y = std::min(uni.min.y, box.min.y);
+		uni.max.x = std::max(uni.max.x, box.max.x);
+		uni.max.y = std::max(uni.max.y, box.max.y);
+	}
+
+	return uni;
+}
+
+std::vector<constraint> get_constraint_difference(constraint box, const std::vector<constraint>& covered) {
+	std::vector<constraint> pieces;
+
+	if (!box.empty()) {
+		pieces.push_back(box);
+	}
+
+	// each covering box cuts the pieces it overlaps into up to four bands around it
+	for (const constraint& cover : covered) {
+		std::vector<constraint> left;
+
+		for (const constraint& piece : pieces) {
+			const constraint inter = get_constraint_intersection({piece, cover});
+
+			if (inter.empty()) {
+				left.push_back(piece);
+				continue;
+			}
+
+			if (inter.min.y > piece.min.y) {
+				left.push_back({piece.min.x, piece.min.y, piece.width(), inter.min.y - piece.min.y});
+			}
+
+			if (inter.max.y < piece.max.y) {
+				left.push_back({piece.min.x, inter.max.y, piece.width(), piece.max.y - inter.max.y});
+			}
+
+			if (inter.min.x > piece.min.x) {
+				left.push_back({piece.min.x, inter.min.y, inter.min.x - piece.min.x, inter.height()});
+			}
+
+			if (inter.max.x < piece.max.x) {
+				left.push_back({inter.max.x, inter.min.y, piece.max.x - inter.max.x, inter.height()});
+			}
+		}
+
+		pieces = std::move(left);
+	}
+
+	return pieces;
+}
+
+std::vector<constraint> merge_overlapping(std::vector<constraint> boxes) {
+	std::erase_if(boxes, [](const constraint& box) { return box.empty(); });
+
+	// a union can grow into boxes it didn't overlap before, so keep going until nothing changes
+	for (bool merged = true; merged;) {
+		merged = false;
+
+		for (size_t i = 0; i < boxes.size() && !merged; i++) {
+			for (size_t j = i + 1; j < boxes.size() && !merged; j++) {
+				if (!get_constraint_intersection({boxes[i], boxes[j]}).empty()) {
+					boxes[i] = get_constraint_union({boxes[i], boxes[j]});
+					boxes.erase(boxes.begin() + j);
+					merged = true;
+				}
+			}
+		}
+	}
+
+	return boxes;
+}
+
 // region viewport
 
 viewport::viewport()
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <initializer_list>
+#include <vector>
 
 struct position {
 	int x = 0;
@@ -34,6 +35,9 @@ struct constraint {
 	int width() const;
 	int height() const;
 
+	// Check if the constraint covers no pixels
+	bool empty() const;
+
 	position offset(const constraint& other) const;
 };
 
@@ -54,3 +58,12 @@ struct viewport {
 };
 
 constraint get_constraint_intersection(std::initializer_list<constraint> boxes);
+
+// Smallest constraint containing all the given ones, empty ones are skipped
+constraint get_constraint_union(std::initializer_list<constraint> boxes);
+
+// Split the part of the box not covered by any of the given constraints into non-overlapping ones
+std::vector<constraint> get_constraint_difference(constraint box, const std::vector<constraint>& covered);
+
+// Replace overlapping constraints by their union until none of them overlap, empty ones are dropped
+std::vector<constraint> merge_overlapping(std::vector<constraint> boxes);
@@ -0,0 +1,148 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "core/blitter.hpp"
+#include "core/memory.hpp"
+#include "core/simd.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// minimum time each benchmark runs for, in seconds
+#define BENCH_MIN_TIME 0.2
+
+static volatile size_t sink = 0;
+
+// Repeat the task until enough time passed and print its throughput
+template <typename F>
+static void measure(const char* name, size_t pixels, F task) {
+	using clock = std::chrono::steady_clock;
+
+	// warm up caches and page in any buffers
+	task();
+
+	const auto start = clock::now();
+	double elapsed = 0;
+	int runs = 0;
+
+	while (elapsed < BENCH_MIN_TIME) {
+		task();
+		runs++;
+		elapsed = std::chrono::duration<double>(clock::now() - start).count();
+	}
+
+	printf("  %-16s %10.1f Mpixel/s\n", name, double(pixels) * runs / elapsed / 1e6);
+}
+
+static void bench_format(const char* name, const format& fmt, int threads) {
+	const struct {
+		const char* name;
+		int width, height;
+	} sizes[] = {
+		{"720p", 1280, 720},
+		{"1080p", 1920, 1080},
+		{"4K", 3840, 2160},
+	};
+
+	const blitter& kernels = blitter::pick(fmt);
+	printf("%s (%s blitter)\n", name, kernels.name);
+
+	for (const auto& size : sizes) {
+		const size_t pixels = size_t(size.width) * size.height;
+		printf(" %s\n", size.name);
+
+		// semi-transparent noise, so blending can't take any shortcuts
+		std::vector<uint8_t> rgba(pixels * 4);
+		uint32_t seed = 0x1234567;
+
+		for (uint8_t& value : rgba) {
+			seed = seed * 1103515245 + 12345;
+			value = seed >> 16;
+		}
+
+		memory_screen screen{size.width, size.height, fmt};
+		screen.set_threads(threads);
+
+		image img{rgba.data(), size.width, size.height};
+
+		measure("blit", pixels, [&] {
+			screen.blit(img);
+		});
+
+		img.blend = true;
+
+		// reads the background back from the screen every time
+		measure("blit blend", pixels, [&] {
+			screen.blit(img);
+		});
+
+		measure("clear", pixels, [&] {
+			screen.clear({10, 20, 30, 255});
+		});
+
+		// kernels on their own, a single row at a time
+		std::vector<uint8_t> row(size.width * 8);
+		std::vector<color> back(size.width);
+
+		measure("copy row", pixels, [&] {
+			for (int y = 0; y < size.height; y++) {
+				kernels.copy(fmt, row.data(), rgba.data() + y * size.width * 4, size.width);
+			}
+		});
+
+		measure("read row", pixels, [&] {
+			for (int y = 0; y < size.height; y++) {
+				kernels.read(fmt, back.data(), row.data(), size.width);
+			}
+		});
+
+		// per-pixel format conversion, as the generic kernels do it
+		measure("encode_rgb", pixels, [&] {
+			size_t total = 0;
+
+			for (size_t i = 0; i < pixels; i++) {
+				total += fmt.encode_rgb(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2]);
+			}
+
+			sink = sink + total;
+		});
+
+		measure("decode_rgb", pixels, [&] {
+			size_t total = 0;
+
+			for (size_t i = 0; i < pixels; i++) {
+				uint8_t r, g, b;
+				fmt.decode_rgb(i, &r, &g, &b);
+				total += r + g + b;
+			}
+
+			sink = sink + total;
+		});
+	}
+}
+
+int main(int argc, char* argv[]) {
+
+	// the number of drawing threads can be given as the only argument
+	const int threads = argc > 1 ? std::stoi(argv[1]) : 1;
+
+	printf("Vector extensions: %s, threads: %d\n", simd_instruction_set(), threads);
+
+	for (const char* name : {"xrgb8888", "rgb565", "bgr888"}) {
+		bench_format(name, memory_screen::named_format(name), threads);
+	}
+}
@@ -0,0 +1,406 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "daemon.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <core/interrupt.hpp>
+#include <core/logger.hpp>
+
+// how often blocked threads check if they should stop, in milliseconds
+#define DAEMON_POLL_MS 100
+
+// how long to wait for a connected client to send its command, in milliseconds
+#define DAEMON_CLIENT_TIMEOUT_MS 1000
+
+// longest accepted command line, in bytes
+#define DAEMON_MAX_LINE 4096
+
+// region helpers
+
+static sockaddr_un get_address(const std::string& path) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+
+	if (path.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error("Socket path '" + path + "' is too long");
+	}
+
+	memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	return address;
+}
+
+static void reply(int client, const std::string& text) {
+	if (client < 0) {
+		return;
+	}
+
+	// the client may have already given up, don't get killed by SIGPIPE
+	send(client, text.data(), text.size(), MSG_NOSIGNAL);
+	close(client);
+}
+
+// Take the file descriptor passed with the message, if there is one
+static void take_descriptor(msghdr& message, int& attached) {
+	for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+		if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+
+		const size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		const int* fds = reinterpret_cast<const int*>(CMSG_DATA(header));
+
+		// only one is expected, close any extra ones
+		for (size_t i = 0; i < count; i++) {
+			if (attached < 0) {
+				attached = fds[i];
+			} else {
+				close(fds[i]);
+			}
+		}
+	}
+}
+
+// Read until the end of the first line (or file), along with an attached descriptor
+static bool read_line(int client, std::string& line, int& attached) {
+	char buffer[256];
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * 4)];
+
+	while (line.size() < DAEMON_MAX_LINE) {
+		pollfd ready{client, POLLIN, 0};
+
+		if (poll(&ready, 1, DAEMON_CLIENT_TIMEOUT_MS) <= 0) {
+			return false;
+		}
+
+		iovec data{buffer, sizeof(buffer)};
+		msghdr message{};
+		message.msg_iov = &data;
+		message.msg_iovlen = 1;
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+
+		const ssize_t count = recvmsg(client, &message, MSG_CMSG_CLOEXEC);
+
+		if (count >= 0) {
+			take_descriptor(message, attached);
+		}
+
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (count <= 0) {
+			return !line.empty();
+		}
+
+		line.append(buffer, count);
+
+		if (const size_t end = line.find('\n'); end != std::string::npos) {
+			line.resize(end);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::vector<std::string> split_command(const std::string& line) {
+	std::vector<std::string> args;
+	std::string arg;
+
+	bool started = false;
+	char quote = 0;
+
+	for (char c : line) {
+		if (quote) {
+			if (c == quote) {
+				quote = 0;
+			} else {
+				arg.push_back(c);
+			}
+		} else if (c == '"' || c == '\'') {
+			quote = c;
+			started = true;
+		} else if (std::isspace(static_cast<unsigned char>(c))) {
+			if (started) {
+				args.push_back(std::move(arg));
+				arg.clear();
+				started = false;
+			}
+		} else {
+			arg.push_back(c);
+			started = true;
+		}
+	}
+
+	if (quote) {
+		throw std::runtime_error("Unterminated quote in command");
+	}
+
+	if (started) {
+		args.push_back(std::move(arg));
+	}
+
+	return args;
+}
+
+std::string join_command(const std::vector<std::string>& args) {
+	std::string line;
+
+	for (const std::string& arg : args) {
+		if (!line.empty()) {
+			line.push_back(' ');
+		}
+
+		const bool plain = !arg.empty() && arg.find_first_of(" \t\n\"'") == std::string::npos;
+
+		if (plain) {
+			line += arg;
+			continue;
+		}
+
+		const char quote = arg.find('"') == std::string::npos ? '"' : '\'';
+		line += quote + arg + quote;
+	}
+
+	return line;
+}
+
+void send_command(const std::string& path, const std::vector<std::string>& args, int attached) {
+	const sockaddr_un address = get_address(path);
+	const int client = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (client < 0) {
+		throw std::runtime_error("Failed to create socket");
+	}
+
+	if (connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		close(client);
+		throw std::runtime_error("Failed to connect to '" + path + "', is the daemon running?");
+	}
+
+	std::string line = join_command(args) + "\n";
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+	iovec data{line.data(), line.size()};
+	msghdr message{};
+	message.msg_iov = &data;
+	message.msg_iovlen = 1;
+
+	if (attached >= 0) {
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+
+		cmsghdr* header = CMSG_FIRSTHDR(&message);
+		header->cmsg_level = SOL_SOCKET;
+		header->cmsg_type = SCM_RIGHTS;
+		header->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(header), &attached, sizeof(int));
+	}
+
+	const bool sent = sendmsg(client, &message, MSG_NOSIGNAL) == ssize_t(line.size());
+	shutdown(client, SHUT_WR);
+
+	if (!sent) {
+		close(client);
+		throw std::runtime_error("Failed to send the command to '" + path + "'");
+	}
+
+	std::string response;
+	char buffer[256];
+	ssize_t count;
+
+	while ((count = read(client, buffer, sizeof(buffer))) != 0) {
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			break;
+		}
+
+		response.append(buffer, count);
+	}
+
+	close(client);
+
+	if (response.empty()) {
+		throw std::runtime_error("Daemon closed the connection");
+	}
+
+	if (!response.starts_with("ok")) {
+		const size_t start = response.starts_with("error: ") ? 7 : 0;
+		throw std::runtime_error(response.substr(start, response.find('\n') - start));
+	}
+}
+
+// region command_server
+
+command_server::command_server(const std::string& path, std::atomic<bool>& cancel)
+	: m_path(path), m_cancel(cancel) {
+
+	const sockaddr_un address = get_address(path);
+	m_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (m_socket < 0) {
+		throw std::runtime_error("Failed to create socket");
+	}
+
+	// left behind by a previous instance that didn't exit cleanly
+	unlink(path.c_str());
+
+	// commands can write files (e.g. '--output'), so only our own user may connect, nobody can before listen()
+	if (bind(m_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || chmod(path.c_str(), 0600) != 0 || listen(m_socket, 8) != 0) {
+		close(m_socket);
+		throw std::runtime_error("Failed to listen on '" + path + "'");
+	}
+
+	m_listener = std::thread(&command_server::listen_for_clients, this);
+}
+
+command_server::~command_server() {
+	m_stopping = true;
+	m_listener.join();
+
+	for (job& left : m_jobs) {
+		reply(left.client, "error: daemon stopped\n");
+
+		if (left.attached >= 0) {
+			close(left.attached);
+		}
+	}
+
+	close(m_socket);
+	unlink(m_path.c_str());
+}
+
+void command_server::push(job next, bool first) {
+	std::lock_guard lock{m_mutex};
+
+	if (first) {
+		m_jobs.push_front(std::move(next));
+	} else {
+		m_jobs.push_back(std::move(next));
+	}
+
+	// the running command may never finish on its own (e.g. a looped animation)
+	if (m_busy) {
+		m_cancel = true;
+	}
+
+	m_ready.notify_one();
+}
+
+void command_server::post(std::vector<std::string> args) {
+	push({std::move(args), -1}, true);
+}
+
+void command_server::listen_for_clients() {
+	while (!m_stopping && !was_interrupted()) {
+		pollfd ready{m_socket, POLLIN, 0};
+
+		if (poll(&ready, 1, DAEMON_POLL_MS) <= 0) {
+			continue;
+		}
+
+		const int client = accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+
+		if (client < 0) {
+			continue;
+		}
+
+		std::string line;
+		int attached = -1;
+
+		// the socket permissions can be changed by its owner, so the peer is checked as well
+		ucred peer{};
+		socklen_t length = sizeof(peer);
+
+		if (!read_line(client, line, attached)) {
+			reply(client, "error: no command received\n");
+		} else if (getsockopt(client, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || (peer.uid != geteuid() && peer.uid != 0)) {
+			reply(client, "error: permission denied\n");
+		} else {
+			try {
+				push({split_command(line), client, attached});
+				continue;
+			} catch (const std::exception& e) {
+				reply(client, std::string("error: ") + e.what() + "\n");
+			}
+		}
+
+		if (attached >= 0) {
+			close(attached);
+		}
+	}
+}
+
+void command_server::run(const handler& execute) {
+	while (!was_interrupted()) {
+		job next;
+
+		{
+			std::unique_lock lock{m_mutex};
+
+			if (!m_ready.wait_for(lock, std::chrono::milliseconds(DAEMON_POLL_MS), [&] { return !m_jobs.empty(); })) {
+				continue;
+			}
+
+			next = std::move(m_jobs.front());
+			m_jobs.pop_front();
+
+			// commands already waiting behind this one replace it right away
+			m_busy = true;
+			m_cancel = !m_jobs.empty();
+		}
+
+		if (next.args.size() == 1 && next.args[0] == "quit") {
+			if (next.attached >= 0) {
+				close(next.attached);
+			}
+
+			reply(next.client, "ok\n");
+			return;
+		}
+
+		std::string result = "ok\n";
+
+		try {
+			execute(next.args, next.attached);
+		} catch (const std::exception& e) {
+			LOG_ERROR("%s\n", e.what());
+			result = std::string("error: ") + e.what() + "\n";
+		}
+
+		if (next.attached >= 0) {
+			close(next.attached);
+		}
+
+		reply(next.client, result);
+
+		std::lock_guard lock{m_mutex};
+		m_busy = false;
+	}
+}
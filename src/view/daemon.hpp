@@ -0,0 +1,90 @@
+// Copyright 2026 Antmicro
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Split a command line into arguments on whitespace, single
+// or double quotes can be used to keep whitespace in an argument
+std::vector<std::string> split_command(const std::string& line);
+
+// Join arguments into a command line, quoting them as needed
+std::string join_command(const std::vector<std::string>& args);
+
+// Send arguments to a daemon listening on the socket, optionally along with a file
+// descriptor, returns once the command finished, throws if it failed
+void send_command(const std::string& path, const std::vector<std::string>& args, int attached = -1);
+
+// Accepts command lines on a Unix socket and executes them one at a time
+// on the thread calling run(), each connection carries a single line that
+// is answered with "ok" or "error: <reason>" once the command finishes,
+// one file descriptor can be attached to the line using SCM_RIGHTS, only
+// processes of the same user (or root) can connect to the socket
+class command_server {
+
+	// Called with the command arguments and the attached file descriptor (or -1),
+	// the descriptor is closed once the handler returns
+	using handler = std::function<void(const std::vector<std::string>&, int)>;
+
+	struct job {
+		std::vector<std::string> args;
+
+		// client waiting for the reply, -1 for posted jobs
+		int client = -1;
+
+		// descriptor sent along with the command, -1 if none
+		int attached = -1;
+	};
+
+	std::string m_path;
+	int m_socket = -1;
+
+	// set while a command runs, to stop it when the next one arrives
+	std::atomic<bool>& m_cancel;
+
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::deque<job> m_jobs;
+	bool m_busy = false;
+
+	std::atomic<bool> m_stopping = false;
+	std::thread m_listener;
+
+	void listen_for_clients();
+	void push(job next, bool first = false);
+
+public:
+
+	// Start listening on the socket, any stale socket file at the path is replaced,
+	// cancel is set whenever a new command should preempt the running one
+	command_server(const std::string& path, std::atomic<bool>& cancel);
+	~command_server();
+
+	command_server(const command_server&) = delete;
+	command_server& operator=(const command_server&) = delete;
+
+	// Queue a command ahead of the received ones, with no client waiting for its result
+	void post(std::vector<std::string> args);
+
+	// Execute commands until interrupted or "quit" is received
+	void run(const handler& execute);
+};
@@ -13,17 +13,34 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <cmath>
 #include <core/interrupt.hpp>
 #include <core/logger.hpp>
+#include <core/stats.hpp>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <linux/dma-buf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
 #ifdef HAS_LIBDRM
 #include "core/drm.hpp"
 #endif
 
+#include "core/arena.hpp"
+#include "core/blitter.hpp"
 #include "core/config.hpp"
 #include "core/framebuffer.hpp"
+#include "core/memory.hpp"
+#include "core/simd.hpp"
+#include "core/splash.hpp"
+#include "daemon.hpp"
 
 static void printo(const std::string_view& text, bool stop_on_colon = true) {
 	bool bold = false;
@@ -50,9 +67,14 @@ static void printo(const std::string_view& text, bool stop_on_colon = true) {
 
 static void usage() {
 	printo("Usage: yav [--image <path>] [--anchor <x> <y>] [--offset <x> <y>]\n", false);
-	printo("           [-v] [--dev <d[:cfg]>] [-c|--clear [color]] [-h|--help]\n", false);
+	printo("           [-v] [--dev <d[:cfg]>] [--buffers <n>] [-c|--clear [color]] [-h|--help]\n", false);
 	printo("           [-b|--blend] [-s|--static] [--time <mspf>] [--loop [times]]\n");
-	printo("           [--view <x> <y> <w> <h>] [--view-anchor <x> <y>]\n");
+	printo("           [--view <x> <y> <w> <h>] [--view-anchor <x> <y>] [--cache [rle]]\n");
+	printo("           [--overlay] [--threads <n>] [--shadow] [--progress <fraction>]\n");
+	printo("           [--daemon <socket>] [--send <socket> [options...]]\n");
+	printo("           [--attach <path>] [--shm <w> <h>] [--dmabuf <w> <h> <pitch>]\n");
+	printo("           [--stats [json]] [--output <path>] [--splash <path>]\n");
+	printo("           [--fit] [--fill] [--scale <factor>]\n");
 }
 
 static void help() {
@@ -60,30 +82,59 @@ static void help() {
 	printf("\nOptions:\n");
 	printo("  -h, --help                 : Show this help page and exit\n");
 	printo("  -v                         : Verbose mode\n");
-	printo("      --dev <device[:cfg]>   : Device type ('fb', 'drm') and config, use '--dev <d>:?' for more info.\n");
-	printo("      --image <path>         : Image file path\n");
+	printo("      --dev <device[:cfg]>   : Device type ('fb', 'drm', 'mem') and config, use '--dev <d>:?' for more info.\n");
+	printo("      --buffers <n>          : Number of DRM scanout buffers (1-3), 1 disables page flipping\n");
+	printo("      --persist              : Keep the image on the DRM screen on exit (Linux 6.8+), and draw over the one already shown on start\n");
+	printo("      --threads <n>          : Number of threads used for drawing, 0 uses one per CPU core\n");
+	printo("      --shadow               : Keep a copy of the screen in RAM, so that it's never read back\n");
+	printo("      --hugetlb              : Allocate large frame buffers from reserved huge pages, if the system has any\n");
+	printo("      --stats [json]         : Print time spent in each stage when done, optionally as JSON\n");
+	printo("      --splash <path>        : Show the image from a file with it already converted for the screen, or save it there\n");
+	printo("      --script <path>        : Draw each line of the file ('-' for standard input) as its own options, shown at once\n");
+	printo("      --output <path>        : Save the screen into a '.png', '.ppm' or raw file when done (with '--dev mem')\n");
+	printo("      --image <path>         : Image file path, '-' reads it from the standard input\n");
 	printo("      --anchor <x> <y>       : Anchor as fractions in range 0 to 1\n");
 	printo("      --offset <x> <y>       : Offset in pixels\n");
-	printo("      --time <mspf>          : Milliseconds per animation frame\n");
+	printo("      --fit                  : Scale the image to the largest size that fits in the viewport\n");
+	printo("      --fill                 : Scale the image to the smallest size that covers the viewport\n");
+	printo("      --scale <factor>       : Scale the image by the given factor, integer factors repeat pixels\n");
+	printo("      --time <mspf>          : Milliseconds per animation frame, overrides delays stored in the file\n");
 	printo("      --loop [times]         : Specify infinite or exact loop count\n");
 	printo("  -c, --clear [color]        : Clear the framebuffer, where color is [0x|#][aa]rrggbb\n");
 	printo("  -s, --static               : Disable animations if present\n");
 	printo("  -b, --blend                : Enable alpha-blending\n");
+	printo("      --cache [rle]          : Convert each animation frame once and reuse it in every loop, 'rle' stores only the pixels that changed\n");
+	printo("      --overlay              : Show the image on a hardware overlay plane, if the device has one (DRM only)\n");
 	printo("      --view <x> <y> <w> <h> : Configure viewport area\n");
 	printo("      --view-anchor <x> <y>  : Viewport anchor as fractions in range 0 to 1\n");
+	printo("      --progress <fraction>  : Only clear the given fraction (0 to 1) of the viewport width, for progress bars\n");
+	printo("      --daemon <socket>      : Keep running and execute options received on a Unix socket\n");
+	printo("      --send <socket> ...    : Send the options that follow to a running daemon and wait for them to finish\n");
+	printo("      --attach <path>        : Open a file and send its descriptor to the daemon along with the options (with '--send')\n");
+	printo("      --shm <w> <h>          : Show RGBA pixels from the attached descriptor, like a memfd (daemon only)\n");
+	printo("      --dmabuf <w> <h> <p>   : Scan out the attached RGBA dmabuf with a pitch of p bytes, without copying it (daemon only)\n");
 	printf("\nEnvironment:\n");
 	printf("  " FB_ENV_PATH " - Linux Framebuffer device path\n");
 	printf("  " DRM_ENV_PATH " - Linux DRM device path\n");
 	printf("  " DRM_ENV_CONN " - Valid Linux DRM connector index\n");
+	printf("  " DRM_ENV_CACHE " - File in which picked DRM outputs are kept, to skip probing in later runs\n");
 	printf("\nExamples:\n");
 	printf("  yav --image example/tuxan.png --anchor 0.5 0.5 --clear ffffff\n");
 	printf("  yav --image example/tuxan.png --anchor 1 1 --offset -100 -100\n");
 	printf("  yav --image example/splash.png --anchor 0.5 0.5 --blend\n");
 	printf("  yav --image example/earth.png --loop\n");
+	printf("  yav --image example/splash.png --fit --anchor 0.5 0.5 --blend\n");
+	printf("  yav --image example/earth.gif --loop --cache\n");
 	printf("  yav --view 0 0 200 10 --clear ff0000\n");
+	printf("  yav --dev mem:1920x1080 --clear 000000 --image example/splash.png --anchor 0.5 0.5 --blend --output splash.raw\n");
+	printf("  yav --clear 000000 --script layers.txt\n");
+	printf("  yav --image example/splash.png --anchor 0.5 0.5 --splash /var/cache/yav/splash.bin\n");
+	printf("  yav --daemon /run/yav.sock --clear 000000\n");
+	printf("  yav --send /run/yav.sock --view 0 0 200 10 --progress 0.5 --clear ff0000\n");
+	printf("  yav --send /run/yav.sock --attach /dev/shm/frame --shm 640 480 --anchor 0.5 0.5\n");
 }
 
-static std::unique_ptr<screen> make_screen(const std::string& descriptor) {
+static std::unique_ptr<screen> make_screen(const std::string& descriptor, int buffers, bool persist) {
 
 	if (descriptor.empty()) {
 		return std::make_unique<framebuffer_screen>("");
@@ -124,39 +175,75 @@ static std::unique_ptr<screen> make_screen(const std::string& descriptor) {
 	if (device == "drm") {
 #ifdef HAS_LIBDRM
 		if (path == "?") {
-			printf("Usage: --dev dev[:[path][@screen]]\n\n");
+			printf("Usage: --dev drm[:[path][@screen[,screen...]]]\n\n");
 			printf("Use Linux Direct Rendering Manager (DRM) device,\n");
 			printf("the optional path given after ':' can be used to point YAV to a specific\n");
 			printf("DRM device driver to use. By default YAV will try to use " DRM_DEV_1 ".\n");
 			printf("The screen is an optional integer given after '@' that specifies the DRM connector to use, by default\n");
 			printf("the value is read from environment variable '" DRM_ENV_CONN "', if that is missing '0' is used.\n");
+			printf("Multiple screens separated by ',' all show the same image, drawn once and copied to each of them,\n");
+			printf("cropped to the size of the smallest one, e.g. '--dev drm:@0,1' drives two displays from one process.\n");
 			printf("As the path is optional '--dev drm:@1' is a valid descriptor.\n\n");
 			exit(0);
 		}
 
-		return std::make_unique<drm_screen>(path);
+		return std::make_unique<drm_screen>(path, buffers, -1, -1, -1, persist);
 #else
+		(void)buffers;
+		(void)persist;
 		printf("This yav build was compiled without DRM support, use --dev fb[:path]!\n");
 		exit(1);
 #endif
 	}
 
-	throw std::runtime_error("Unknown device '" + device + "' (expected 'fb', 'drm'), did you forget the ':'?");
+	// screen in system memory, saved with '--output'
+	if (device == "mem") {
+		if (path == "?") {
+			printf("Usage: --dev mem:<width>x<height>[@format]\n\n");
+			printf("Draw into system memory instead of a device, use '--output <path>' to save\n");
+			printf("the result. The format is one of 'xrgb8888' (the default), 'argb8888', 'xbgr8888',\n");
+			printf("'bgr888' or 'rgb565'. Pre-rendered raw output can later be copied into a device as-is.\n\n");
+			exit(0);
+		}
+
+		const size_t cross = path.find('x');
+		const size_t at = path.find('@');
+
+		if (cross == std::string::npos) {
+			throw std::runtime_error("Expected memory screen size as '<width>x<height>', use '--dev mem:?' for more info");
+		}
+
+		const int width = std::stoi(path.substr(0, cross));
+		const int height = std::stoi(path.substr(cross + 1, at));
+		const format fmt = memory_screen::named_format(at == std::string::npos ? "xrgb8888" : path.substr(at + 1));
+
+		return std::make_unique<memory_screen>(width, height, fmt);
+	}
+
+	throw std::runtime_error("Unknown device '" + device + "' (expected 'fb', 'drm', 'mem'), did you forget the ':'?");
 }
 
-static void entry(const std::vector<std::string>& args) {
+// Lookup of options, given either on the command line or in a daemon command
+class options {
 
-	if (args.empty()) {
-		usage();
-		printf("Run 'yav --help' for more information!\n");
-		return;
+	const std::vector<std::string>& args;
+
+public:
+
+	using iterator = std::vector<std::string>::const_iterator;
+
+	options(const std::vector<std::string>& args)
+		: args(args) {}
+
+	iterator end() const {
+		return args.end();
 	}
 
-	auto get_flag = [&](const char* option) {
+	iterator get_flag(const char* option) const {
 		return std::find(args.begin(), args.end(), option);
-	};
+	}
 
-	auto get_either_flag = [&](const char* first, const char* second) {
+	iterator get_either_flag(const char* first, const char* second) const {
 		auto it = get_flag(first);
 
 		if (it != args.end()) {
@@ -164,108 +251,576 @@ static void entry(const std::vector<std::string>& args) {
 		}
 
 		return get_flag(second);
-	};
+	}
 
-	auto next_value = [&](decltype(args.begin())& it) -> std::string {
+	std::string next_value(iterator& it) const {
 		++it;
 		return (it == args.end()) ? "" : *it;
+	}
+
+	const std::vector<std::string>& all() const {
+		return args;
+	}
+};
+
+// What the image is shown from, a splash file, rows decoded straight into the screen or the image itself being decoded
+struct image_source {
+	std::unique_ptr<splash_file> splash;
+	std::unique_ptr<row_decoder> rows;
+	std::future<std::unique_ptr<image>> loading;
+};
+
+static std::future<std::unique_ptr<image>> load_image(const options& opts) {
+	if (auto it = opts.get_flag("--image"); it != opts.end()) {
+		return image::load_async(opts.next_value(it));
+	}
+
+	return {};
+}
+
+// Identifies what a splash file is rendered from, so changing any of
+// the options or replacing the image file makes the old one out of date
+static uint64_t splash_key(const options& opts) {
+	uint64_t hash = 0xcbf29ce484222325;
+
+	const auto mix = [&](const void* data, size_t size) {
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 0x100000001b3;
+		}
 	};
 
-	if (get_flag("--help") != args.end() || get_flag("-h") != args.end()) {
-		help();
-		return;
+	for (const std::string& arg : opts.all()) {
+		mix(arg.c_str(), arg.size() + 1);
 	}
 
-	std::string fbdev_path;
+	struct stat info{};
 
-	if (auto it = get_flag("--dev"); it != args.end()) {
-		fbdev_path = next_value(it);
+	if (auto it = opts.get_flag("--image"); it != opts.end() && stat(opts.next_value(it).c_str(), &info) == 0) {
+		mix(&info.st_size, sizeof(info.st_size));
+		mix(&info.st_mtim, sizeof(info.st_mtim));
 	}
 
-	auto screen = make_screen(fbdev_path);
+	return hash;
+}
+
+// Open the splash file, if one was given and is up to date
+static std::unique_ptr<splash_file> open_splash(const options& opts) {
+	auto it = opts.get_flag("--splash");
 
-	if (get_flag("-v") != args.end()) {
-		screen->dump();
+	if (it == opts.end()) {
+		return nullptr;
+	}
+
+	const std::string path = opts.next_value(it);
+
+	// it will be written once the image is shown
+	if (!std::filesystem::exists(path)) {
+		return nullptr;
+	}
+
+	try {
+		auto splash = std::make_unique<splash_file>(path);
+
+		if (splash->key() == splash_key(opts)) {
+			return splash;
+		}
+
+		LOG_INFO("Splash file '%s' is out of date, it will be saved again\n", path.c_str());
+	} catch (const std::exception& e) {
+		LOG_WARN("%s, it will be saved again!\n", e.what());
+	}
+
+	return nullptr;
+}
+
+// Open the image for decoding by rows, if it's in a format that allows it and none of the options
+// given need the whole decoded image to be kept around, rows are always drawn opaque, so blended
+// images (e.g. 32 bit BMPs with alpha) are left to the regular path
+static std::unique_ptr<row_decoder> open_rows(const options& opts) {
+	auto it = opts.get_flag("--image");
+
+	if (it == opts.end()) {
+		return nullptr;
+	}
+
+	for (const char* flag : {"-b", "--blend", "--fit", "--fill", "--scale", "--cache", "--overlay", "--splash", "--loop"}) {
+		if (opts.get_flag(flag) != opts.end()) {
+			return nullptr;
+		}
+	}
+
+	// errors are reported when the image is loaded the regular way
+	try {
+		return row_decoder::open(opts.next_value(it));
+	} catch (const std::exception&) {
+		return nullptr;
+	}
+}
+
+static image_source start_loading(const options& opts) {
+	image_source source;
+	source.splash = open_splash(opts);
+
+	// an up to date splash file is shown without decoding the image at all
+	if (!source.splash) {
+		source.rows = open_rows(opts);
+	}
+
+	if (!source.splash && !source.rows) {
+		source.loading = load_image(opts);
+	}
+
+	return source;
+}
+
+// Apply options placing an image or buffer of the given size within the viewport
+static void place(viewport& area, const options& opts) {
+	if (auto it = opts.get_flag("--anchor"); it != opts.end()) {
+		area.ax = std::stof(opts.next_value(it));
+		area.ay = std::stof(opts.next_value(it));
+	}
+
+	if (auto it = opts.get_flag("--offset"); it != opts.end()) {
+		area.ox = std::stoi(opts.next_value(it));
+		area.oy = std::stoi(opts.next_value(it));
+	}
+}
+
+// Apply options scaling the image relative to the viewport
+static void scale(const screen& screen, const options& opts, image& img) {
+	const constraint area = screen.get_view_area();
+	const double horizontal = double(area.width()) / img.width();
+	const double vertical = double(area.height()) / img.height();
+
+	double factor = 0;
+
+	if (auto it = opts.get_flag("--scale"); it != opts.end()) {
+		factor = std::stod(opts.next_value(it));
+	}
+
+	if (opts.get_flag("--fit") != opts.end()) {
+		factor = std::min(horizontal, vertical);
+	}
+
+	if (opts.get_flag("--fill") != opts.end()) {
+		factor = std::max(horizontal, vertical);
+	}
+
+	if (factor > 0) {
+		img.resize(std::max(1L, std::lround(img.width() * factor)), std::max(1L, std::lround(img.height() * factor)));
+	}
+}
+
+// Apply image options and show it, saving it into a splash file if requested
+static void show(screen& screen, const options& opts, image& img, bool splash = false) {
+	bool used_animation_flags = false;
+
+	// anchors and offsets apply to the scaled image
+	scale(screen, opts, img);
+	place(img, opts);
+
+	if (auto it = opts.get_flag("--time"); it != opts.end()) {
+		used_animation_flags = true;
+		img.mspt = std::stoi(opts.next_value(it)) * 1000; // micro to milli
+		img.file_timing = false;
+	}
+
+	if (auto it = opts.get_flag("--loop"); it != opts.end()) {
+		used_animation_flags = true;
+		int times = -1;
+		auto next = it + 1;
+
+		if (next != opts.end() && !next->empty() && std::isdigit(next->at(0))) {
+			try {
+				times = std::stoi(*next);
+			} catch (const std::exception&) {
+				printf("Invalid value given to '--loop'!\n");
+				return;
+			}
+		}
+
+		img.loops = times;
+	}
+
+	if (opts.get_flag("-b") != opts.end() || opts.get_flag("--blend") != opts.end()) {
+		img.blend = true;
+	}
+
+	if (auto it = opts.get_flag("--cache"); it != opts.end()) {
+		img.cache = true;
+		img.compress = opts.next_value(it) == "rle";
+	}
+
+	if (opts.get_flag("--overlay") != opts.end()) {
+		img.overlay = true;
+	}
+
+	if (opts.get_flag("--static") != opts.end() || opts.get_flag("-s") != opts.end()) {
+
+		if (used_animation_flags) {
+			printf("Option '--static' cannot be used with neither '--loop' nor '--time'!\n");
+			return;
+		}
+
+		img.frames = 1;
+		img.loops = 1;
+	}
+
+	// the overlay plane can't be saved, as the image is never drawn into the screen
+	if (auto it = opts.get_flag("--splash"); splash && it != opts.end()) {
+		if (img.overlay) {
+			LOG_WARN("Images shown with '--overlay' can't be saved into a splash file!\n");
+		} else {
+
+			// the splash only speeds up the next boot, failing to save it shouldn't keep the image from being shown
+			try {
+				screen.save_splash(img, opts.next_value(it), splash_key(opts));
+			} catch (const std::exception& e) {
+				LOG_WARN("%s, the splash file was not saved!\n", e.what());
+			}
+		}
+	}
+
+	screen.blit(img);
+}
+
+// Show RGBA pixels from a memory mapped descriptor, like a memfd or dmabuf
+static void show_shared(screen& screen, const options& opts, int fd, int width, int height, int pitch) {
+
+	// the descriptor and its layout come from the client, so check them before touching its memory
+	if (width <= 0 || height <= 0) {
+		throw std::runtime_error("Invalid shared buffer size " + std::to_string(width) + "x" + std::to_string(height));
+	}
+
+	if (pitch <= 0 || size_t(pitch) < size_t(width) * 4) {
+		throw std::runtime_error("Shared buffer pitch " + std::to_string(pitch) + " is too small for width " + std::to_string(width));
+	}
+
+	const size_t size = size_t(pitch) * height;
+	const off_t available = lseek(fd, 0, SEEK_END);
+
+	if (available < 0 || size_t(available) < size) {
+		throw std::runtime_error("Shared buffer is smaller than the " + std::to_string(size) + " bytes its size needs");
+	}
+
+	void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if (map == MAP_FAILED) {
+		throw std::runtime_error("Unable to map the shared buffer");
+	}
+
+	// dmabufs need CPU access to be bracketed, this fails harmlessly for other files
+	dma_buf_sync sync{DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ};
+	ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+
+	const auto* pixels = static_cast<uint8_t*>(map);
+	std::vector<uint8_t> packed;
+
+	// images are tightly packed, so padded rows have to be copied
+	if (pitch != width * 4) {
+		packed.resize(size_t(width) * height * 4);
+
+		for (int y = 0; y < height; y++) {
+			memcpy(packed.data() + size_t(y) * width * 4, pixels + size_t(y) * pitch, size_t(width) * 4);
+		}
+
+		pixels = packed.data();
+	}
+
+	try {
+		image img{const_cast<uint8_t*>(pixels), width, height};
+		show(screen, opts, img);
+	} catch (...) {
+		sync.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ;
+		ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+		munmap(map, size);
+		throw;
 	}
 
-	if (auto it = get_flag("--view"); it != args.end()) {
-		screen->view.ox = std::stoi(next_value(it));
-		screen->view.oy = std::stoi(next_value(it));
-		screen->view.w = std::stoi(next_value(it));
-		screen->view.h = std::stoi(next_value(it));
+	sync.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ;
+	ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+	munmap(map, size);
+}
+
+// Apply options that change what is shown on the screen
+static void draw(screen& screen, const options& opts, image_source source, int attached = -1) {
 
-		if (auto it = get_flag("--view-anchor"); it != args.end()) {
-			screen->view.ax = std::stof(next_value(it));
-			screen->view.ay = std::stof(next_value(it));
+	if (auto it = opts.get_flag("--view"); it != opts.end()) {
+		screen.view.ox = std::stoi(opts.next_value(it));
+		screen.view.oy = std::stoi(opts.next_value(it));
+		screen.view.w = std::stoi(opts.next_value(it));
+		screen.view.h = std::stoi(opts.next_value(it));
+
+		if (auto it = opts.get_flag("--view-anchor"); it != opts.end()) {
+			screen.view.ax = std::stof(opts.next_value(it));
+			screen.view.ay = std::stof(opts.next_value(it));
 		}
 	}
 
-	if (auto it = get_either_flag("-c", "--clear"); it != args.end()) {
+	// the viewport is kept between daemon commands, so only shrink it while drawing
+	const viewport full = screen.view;
+
+	if (auto it = opts.get_flag("--progress"); it != opts.end()) {
+		const float progress = std::clamp(std::stof(opts.next_value(it)), 0.0f, 1.0f);
+		const int width = full.w == -1 ? screen.width() : full.w;
+
+		screen.view.w = std::lround(width * progress);
+	}
+
+	if (auto it = opts.get_either_flag("-c", "--clear"); it != opts.end()) {
 		auto next = it + 1;
 		color c{};
 
-		if ((next != args.end()) && !next->empty() && !next->starts_with("-")) {
+		if ((next != opts.end()) && !next->empty() && !next->starts_with("-")) {
 			c = color::parse(next->c_str());
 		}
 
-		screen->clear(c);
+		if (screen.view.w != 0) {
+			screen.clear(c);
+		}
 	}
 
-	if (auto it = get_flag("--image"); it != args.end()) {
-		image img{next_value(it)};
+	screen.view = full;
 
-		bool used_animation_flags = false;
+	if (source.splash && !screen.blit_splash(*source.splash)) {
+		LOG_INFO("Splash file was saved for a different screen, it will be saved again\n");
+
+		source.splash.reset();
+		source.loading = load_image(opts);
+	}
+
+	if (source.rows) {
+		viewport area;
+		area.w = source.rows->width();
+		area.h = source.rows->height();
+
+		place(area, opts);
+		screen.blit_rows(*source.rows, area);
+	}
 
-		if (auto it = get_flag("--anchor"); it != args.end()) {
-			img.ax = std::stof(next_value(it));
-			img.ay = std::stof(next_value(it));
+	if (source.loading.valid()) {
+		const std::unique_ptr<image> loaded = source.loading.get();
+		show(screen, opts, *loaded, true);
+	}
+
+	if (auto it = opts.get_flag("--shm"); it != opts.end()) {
+		const int width = std::stoi(opts.next_value(it));
+		const int height = std::stoi(opts.next_value(it));
+
+		if (attached < 0) {
+			throw std::runtime_error("Option '--shm' needs a file descriptor sent along with the command");
 		}
 
-		if (auto it = get_flag("--offset"); it != args.end()) {
-			img.ox = std::stoi(next_value(it));
-			img.oy = std::stoi(next_value(it));
+		show_shared(screen, opts, attached, width, height, width * 4);
+	}
+
+	if (auto it = opts.get_flag("--dmabuf"); it != opts.end()) {
+		viewport area;
+		area.w = std::stoi(opts.next_value(it));
+		area.h = std::stoi(opts.next_value(it));
+		const int pitch = std::stoi(opts.next_value(it));
+
+		if (attached < 0) {
+			throw std::runtime_error("Option '--dmabuf' needs a file descriptor sent along with the command");
 		}
 
-		if (auto it = get_flag("--time"); it != args.end()) {
-			used_animation_flags = true;
-			img.mspt = std::stoi(next_value(it)) * 1000; // micro to milli
+		place(area, opts);
+
+		// scanning the buffer out directly means the CPU never touches it
+		if (!screen.show_dmabuf(attached, area, pitch)) {
+			show_shared(screen, opts, attached, area.w, area.h, pitch);
 		}
+	}
+}
 
-		if (auto it = get_flag("--loop"); it != args.end()) {
-			used_animation_flags = true;
-			int times = -1;
-			auto next = it + 1;
-
-			if (!next->empty() && std::isdigit(next->at(0))) {
-				try {
-					times = std::stoi(*(it + 1));
-					++it;
-				} catch (const std::exception&) {
-					printf("Invalid value given to '--loop'!\n");
-					return;
-				}
-			}
+// Read the options of each line of the script, '-' reads it from
+// the standard input, empty lines and ones starting with '#' are skipped
+static std::vector<std::vector<std::string>> read_script(const std::string& path) {
+	std::ifstream file;
 
-			img.loops = times;
+	if (path != "-") {
+		file.open(path);
+
+		if (!file) {
+			throw std::runtime_error("Failed to open script '" + path + "'");
 		}
+	}
 
-		if (get_flag("-b") != args.end() || get_flag("--blend") != args.end()) {
-			img.blend = true;
+	std::istream& input = path == "-" ? std::cin : file;
+	std::vector<std::vector<std::string>> commands;
+	std::string line;
+
+	while (std::getline(input, line)) {
+		const size_t start = line.find_first_not_of(" \t");
+
+		if (start == std::string::npos || line[start] == '#') {
+			continue;
 		}
 
-		if (get_flag("--static") != args.end() || get_flag("-s") != args.end()) {
+		// split the same way as commands sent to a daemon
+		commands.push_back(split_command(line));
+	}
 
-			if (used_animation_flags) {
-				printf("Option '--static' cannot be used with neither '--loop' nor '--time'!\n");
-				return;
+	return commands;
+}
+
+// Draw each line of the script given with '--script', as if it was given on its own
+static void run_script(screen& screen, const options& opts) {
+	auto it = opts.get_flag("--script");
+
+	if (it == opts.end()) {
+		return;
+	}
+
+	const std::vector<std::vector<std::string>> commands = read_script(opts.next_value(it));
+	std::vector<image_source> sources;
+
+	// all images start decoding at once, so later layers load while the earlier ones are drawn
+	for (const std::vector<std::string>& command : commands) {
+		sources.push_back(start_loading(options{command}));
+	}
+
+	for (size_t i = 0; i < commands.size(); i++) {
+		draw(screen, options{commands[i]}, std::move(sources[i]));
+	}
+}
+
+// Save what was drawn into a file, only memory screens can be saved
+static void save(const screen& screen, const options& opts) {
+	if (auto it = opts.get_flag("--output"); it != opts.end()) {
+		const auto* memory = dynamic_cast<const memory_screen*>(&screen);
+
+		if (memory == nullptr) {
+			throw std::runtime_error("Option '--output' can only be used with '--dev mem'");
+		}
+
+		memory->save(opts.next_value(it));
+	}
+}
+
+// Print collected timings if requested, '--stats json' prints them as a JSON object
+static void report(const options& opts) {
+	if (auto it = opts.get_flag("--stats"); it != opts.end()) {
+		print_stats(opts.next_value(it) == "json");
+	}
+}
+
+static void entry(const std::vector<std::string>& args) {
+
+	if (args.empty()) {
+		usage();
+		printf("Run 'yav --help' for more information!\n");
+		return;
+	}
+
+	const options opts{args};
+
+	if (opts.get_flag("--help") != opts.end() || opts.get_flag("-h") != opts.end()) {
+		help();
+		return;
+	}
+
+	// everything after the socket path is meant for the daemon
+	if (auto it = opts.get_flag("--send"); it != opts.end()) {
+		const std::string path = opts.next_value(it);
+		std::vector<std::string> command{it == opts.end() ? it : it + 1, opts.end()};
+
+		// the file is opened here and its descriptor is sent to the daemon
+		int attached = -1;
+
+		if (auto at = std::find(command.begin(), command.end(), "--attach"); at != command.end()) {
+			const std::string file = at + 1 == command.end() ? "" : *(at + 1);
+			command.erase(at, std::min(at + 2, command.end()));
+
+			attached = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+
+			if (attached < 0) {
+				throw std::runtime_error("Failed to open '" + file + "'");
 			}
+		}
 
-			img.frames = 1;
-			img.loops = 1;
+		send_command(path, command, attached);
+		return;
+	}
+
+	// stats are enabled before anything is timed
+	if (auto it = opts.get_flag("--stats"); it != opts.end()) {
+		enable_stats();
+	}
+
+	if (opts.get_flag("--hugetlb") != opts.end()) {
+		buffer_arena::shared().use_hugetlb(true);
+	}
+
+	// decode the image while the screen is opened and cleared, which
+	// can take a while, so that it can be shown as soon as possible
+	image_source source = start_loading(opts);
+
+	std::string fbdev_path;
+
+	if (auto it = opts.get_flag("--dev"); it != opts.end()) {
+		fbdev_path = opts.next_value(it);
+	}
+
+	int buffers = DRM_DEFAULT_BUFFERS;
+
+	if (auto it = opts.get_flag("--buffers"); it != opts.end()) {
+		buffers = std::stoi(opts.next_value(it));
+	}
+
+	std::unique_ptr<screen> screen;
+
+	{
+		stat_timer timer{"open"};
+		screen = make_screen(fbdev_path, buffers, opts.get_flag("--persist") != opts.end());
+	}
+
+	if (auto it = opts.get_flag("--threads"); it != opts.end()) {
+		screen->set_threads(std::stoi(opts.next_value(it)));
+	}
+
+	if (opts.get_flag("--shadow") != opts.end()) {
+		screen->set_shadow(true);
+	}
+
+	if (opts.get_flag("-v") != opts.end()) {
+		screen->dump();
+		printf("Using '%s' blitter (vector extensions: %s)\n", blitter::pick(screen->form()).name, simd_instruction_set());
+	}
+
+	auto it = opts.get_flag("--daemon");
+
+	if (it == opts.end()) {
+
+		// layers of a script are shown together, with one update of the screen
+		if (opts.get_flag("--script") != opts.end()) {
+			screen->begin_batch();
 		}
 
-		screen->blit(img);
+		draw(*screen, opts, std::move(source));
+		run_script(*screen, opts);
+		screen->end_batch();
+
+		save(*screen, opts);
+		report(opts);
+		return;
 	}
+
+	// keep the screen open, so that showing the next image is just a blit
+	command_server server{opts.next_value(it), screen->cancel};
+
+	// options given with --daemon are drawn first, with the image that is already loading
+	server.post(args);
+	bool first = true;
+
+	server.run([&](const std::vector<std::string>& command, int attached) {
+		const options received{command};
+		draw(*screen, received, first ? std::move(source) : start_loading(received), attached);
+		first = false;
+		save(*screen, received);
+	});
+
+	report(opts);
 }
 
 int main(int argc, char* argv[]) {
@@ -12,7 +12,26 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "core/arena.hpp"
+#include "core/blitter.hpp"
+#include "core/cache.hpp"
+#include "core/clock.hpp"
+#include "core/compositor.hpp"
+#include "core/config.hpp"
+#include "core/kernels.hpp"
+#include "core/memory.hpp"
 #include "core/framebuffer.hpp"
+#include "core/pool.hpp"
+#include "core/queue.hpp"
+#include "core/rows.hpp"
+#include "core/scale.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 #define ASSERT(...)                                            \
 	if (!(__VA_ARGS__)) {                                      \
@@ -50,7 +69,606 @@ static void test_framebuffer_format() {
 	ASSERT(b == 0)
 }
 
+static void test_blitter_blend() {
+
+	color front{200, 100, 0, 0};
+	blend_pixel(front, {10, 20, 30});
+	ASSERT(front.r == 10 && front.g == 20 && front.b == 30)
+
+	front = {200, 100, 0, 255};
+	blend_pixel(front, {10, 20, 30});
+	ASSERT(front.r == 200 && front.g == 100 && front.b == 0)
+
+	front = {255, 0, 100, 128};
+	blend_pixel(front, {0, 255, 100});
+	ASSERT(front.r == 128 && front.g == 127 && front.b == 100)
+}
+
+static void test_blitter_specialized() {
+
+	const format formats[] = {
+		{32, {8, 16}, {8, 8}, {8, 0}, {8, 24}},
+		{32, {8, 0}, {8, 8}, {8, 16}, {}},
+		{24, {8, 16}, {8, 8}, {8, 0}, {}},
+		{16, {5, 11}, {6, 5}, {5, 0}, {}},
+	};
+
+	// long enough to cover both the vectorized body and the scalar tail
+	const int count = 37;
+	uint8_t src[count * 4];
+	color back[count];
+
+	uint32_t seed = 0x1234567;
+
+	for (int i = 0; i < count; i++) {
+		for (int c = 0; c < 4; c++) {
+			seed = seed * 1103515245 + 12345;
+			src[i * 4 + c] = seed >> 16;
+		}
+
+		seed = seed * 1103515245 + 12345;
+		back[i] = {uint8_t(seed >> 8), uint8_t(seed >> 16), uint8_t(seed >> 24)};
+	}
+
+	// fully transparent and fully opaque pixels
+	src[3] = 0;
+	src[7] = 255;
+
+	// whole vectors of them, which skip the blending arithmetic
+	for (int i = 8; i < 24; i++) {
+		src[i * 4 + 3] = i < 16 ? 255 : 0;
+	}
+
+	for (const format& fmt : formats) {
+		const blitter& fast = blitter::pick(fmt);
+		const blitter& slow = blitter::fallback();
+
+		ASSERT(&fast != &slow)
+
+		uint8_t expected[count * 4] = {};
+		uint8_t actual[count * 4] = {};
+
+		slow.copy(fmt, expected, src, count);
+		fast.copy(fmt, actual, src, count);
+		ASSERT(memcmp(expected, actual, sizeof(actual)) == 0)
+
+		slow.blend(fmt, expected, src, back, count);
+		fast.blend(fmt, actual, src, back, count);
+		ASSERT(memcmp(expected, actual, sizeof(actual)) == 0)
+
+		color decoded_expected[count], decoded_actual[count];
+		slow.read(fmt, decoded_expected, expected, count);
+		fast.read(fmt, decoded_actual, actual, count);
+		ASSERT(memcmp(decoded_expected, decoded_actual, sizeof(decoded_actual)) == 0)
+
+		slow.fill(fmt, expected, {1, 2, 3, 100}, count);
+		fast.fill(fmt, actual, {1, 2, 3, 100}, count);
+		ASSERT(memcmp(expected, actual, sizeof(actual)) == 0)
+	}
+
+	format exotic{32, {10, 20}, {10, 10}, {10, 0}, {}};
+	ASSERT(&blitter::pick(exotic) == &blitter::fallback())
+}
+
+static void test_viewport_union() {
+
+	constraint uni = get_constraint_union({{}, {4, 2, 3, 1}, {1, 5, 2, 2}});
+	ASSERT(uni.min.x == 1 && uni.min.y == 2)
+	ASSERT(uni.max.x == 7 && uni.max.y == 7)
+
+	ASSERT(get_constraint_union({{}, {3, 3, 0, 5}}).empty())
+
+	// an L-shaped difference is split into two bands, and nothing is left of a covered box
+	const std::vector<constraint> left = get_constraint_difference({0, 0, 4, 4}, {{2, 2, 4, 4}});
+	ASSERT(left.size() == 2)
+	ASSERT(left[0].width() * left[0].height() + left[1].width() * left[1].height() == 12)
+	ASSERT(get_constraint_difference({1, 1, 2, 2}, {{0, 0, 2, 4}, {2, 0, 2, 4}}).empty())
+}
+
+static void test_pool_run() {
+
+	thread_pool pool{4};
+	ASSERT(pool.size() == 4)
+
+	std::vector<int> hits(100);
+
+	// run a few times, to make sure workers pick up later jobs too
+	for (int i = 0; i < 3; i++) {
+		pool.run(hits.size(), [&](int task) { hits[task]++; });
+	}
+
+	for (int count : hits) {
+		ASSERT(count == 3)
+	}
+
+	// jobs of callers on different threads don't get mixed up
+	std::vector<int> first(500), second(700);
+
+	std::thread other{[&] {
+		for (int i = 0; i < 20; i++) {
+			pool.run(second.size(), [&](int task) { second[task]++; });
+		}
+	}};
+
+	for (int i = 0; i < 20; i++) {
+		pool.run(first.size(), [&](int task) { first[task]++; });
+	}
+
+	other.join();
+	ASSERT(std::all_of(first.begin(), first.end(), [](int count) { return count == 20; }))
+	ASSERT(std::all_of(second.begin(), second.end(), [](int count) { return count == 20; }))
+}
+
+static void test_clock_deadline() {
+
+	frame_clock clock;
+	ASSERT(clock.lag() >= 0)
+
+	// the deadline moves by the given time, not from the time it's waited for
+	clock.advance(20'000);
+	ASSERT(clock.lag() < 0)
+
+	clock.wait();
+	ASSERT(clock.lag() >= 0)
+
+	clock.restart();
+	clock.advance(-5'000);
+	ASSERT(clock.lag() >= 5'000)
+}
+
+static void test_memory_screen_blit() {
+
+	memory_screen screen{4, 3, memory_screen::named_format("xrgb8888"), 20};
+	ASSERT(screen.line_length() == 20)
+
+	uint8_t rgba[2 * 2 * 4] = {};
+	rgba[0] = 10;
+	rgba[1] = 20;
+	rgba[2] = 30;
+
+	image img{rgba, 2, 2};
+	img.ox = 1;
+	img.oy = 1;
+
+	screen.clear({1, 2, 3, 255});
+	screen.blit(img);
+
+	// pixels are stored as B, G, R, X
+	const uint8_t* pixels = screen.pixels();
+	ASSERT(pixels[0] == 3 && pixels[1] == 2 && pixels[2] == 1)
+	ASSERT(pixels[20 + 4] == 30 && pixels[20 + 5] == 20 && pixels[20 + 6] == 10)
+	ASSERT(pixels[20 + 12] == 3)
+}
+
+static void test_image_spans() {
+
+	// opaque, transparent, two translucent and opaque pixels, the other rows are empty
+	const int w = 16;
+	const int h = 4;
+	const uint8_t alpha[5] = {255, 0, 100, 20, 255};
+
+	std::vector<uint8_t> rgba(w * h * 4);
+
+	for (int x = 0; x < 5; x++) {
+		rgba[x * 4] = 200;
+		rgba[x * 4 + 3] = alpha[x];
+	}
+
+	image img{rgba.data(), w, h};
+	img.blend = true;
+
+	ASSERT(img.has_spans())
+	ASSERT(img.visible_spans(0).size() == 3)
+	ASSERT(img.visible_spans(0)[1].start == 2 && img.visible_spans(0)[1].end == 4 && !img.visible_spans(0)[1].opaque)
+	ASSERT(img.visible_spans(1).empty())
+
+	// cached frames are rendered whole, which gives the reference result
+	image whole{rgba.data(), w, h};
+	whole.blend = true;
+	whole.cache = true;
+	whole.loops = 2;
+
+	memory_screen expected{w, h, memory_screen::named_format("xrgb8888")};
+	memory_screen actual{w, h, memory_screen::named_format("xrgb8888")};
+
+	expected.clear({10, 20, 30, 255});
+	actual.clear({10, 20, 30, 255});
+
+	expected.blit(whole);
+	actual.blit(img);
+	ASSERT(memcmp(expected.pixels(), actual.pixels(), w * h * 4) == 0)
+
+	// alternating alpha makes too many runs to be worth indexing
+	for (int i = 0; i < w * h; i++) {
+		rgba[i * 4 + 3] = i % 2 ? 255 : 128;
+	}
+
+	image noisy{rgba.data(), w, h};
+	ASSERT(!noisy.has_spans())
+}
+
+static void test_scale_rgba() {
+
+	// integer factors repeat pixels
+	const uint8_t pixels[2 * 4] = {1, 2, 3, 255, 4, 5, 6, 128};
+	uint8_t repeated[4 * 2 * 4];
+
+	scale_rgba(pixels, 2, 1, repeated, 4, 2);
+	ASSERT(memcmp(repeated + 4, pixels, 4) == 0 && memcmp(repeated + 8, pixels + 4, 4) == 0)
+	ASSERT(memcmp(repeated, repeated + 16, 16) == 0)
+
+	// filtering a single color gives the same color, enlarging and shrinking
+	std::vector<uint8_t> flat(7 * 5 * 4);
+
+	for (size_t i = 0; i < flat.size(); i += 4) {
+		flat[i] = 200;
+		flat[i + 1] = 10;
+		flat[i + 2] = 90;
+		flat[i + 3] = 255;
+	}
+
+	for (auto [w, h] : {std::pair{11, 3}, std::pair{3, 2}, std::pair{1, 1}}) {
+		std::vector<uint8_t> out(w * h * 4);
+		scale_rgba(flat.data(), 7, 5, out.data(), w, h);
+
+		for (size_t i = 0; i < out.size(); i += 4) {
+			ASSERT(out[i] == 200 && out[i + 1] == 10 && out[i + 2] == 90 && out[i + 3] == 255)
+		}
+	}
+
+	// transparent pixels don't change the color of visible ones
+	const uint8_t edge[3 * 4] = {255, 0, 0, 255, 0, 255, 0, 0, 255, 0, 0, 255};
+	uint8_t half[2 * 4];
+
+	scale_rgba(edge, 3, 1, half, 2, 1);
+	ASSERT(half[0] == 255 && half[1] == 0 && half[3] > 0 && half[3] < 255)
+
+	// changed regions grow to cover everything the filter touches
+	const constraint changed = scale_region({1, 1, 1, 1}, 3, 3, 6, 9);
+	ASSERT(changed.min.x == 0 && changed.min.y == 0 && changed.max.x == 6 && changed.max.y == 9)
+}
+
+static void test_row_decoder() {
+
+	// a 2x2 PPM with a comment, and the same pixels as a bottom-up 24 bit BMP with padded rows
+	const char header[] = "P6\n# yav\n2 2\n255\n";
+	const uint8_t rgb[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+
+	uint8_t bmp[54 + 16] = {'B', 'M'};
+	bmp[10] = 54;
+	bmp[14] = 40;
+	bmp[18] = 2;
+	bmp[22] = 2;
+	bmp[26] = 1;
+	bmp[28] = 24;
+
+	for (int y = 0; y < 2; y++) {
+		for (int x = 0; x < 2; x++) {
+			const uint8_t* pixel = rgb + (y * 2 + x) * 3;
+			uint8_t* stored = bmp + 54 + (1 - y) * 8 + x * 3;
+
+			stored[0] = pixel[2];
+			stored[1] = pixel[1];
+			stored[2] = pixel[0];
+		}
+	}
+
+	const char* ppm_path = "yav_test_rows.ppm";
+	const char* bmp_path = "yav_test_rows.bmp";
+
+	FILE* file = fopen(ppm_path, "wb");
+	fwrite(header, 1, sizeof(header) - 1, file);
+	fwrite(rgb, 1, sizeof(rgb), file);
+	fclose(file);
+
+	file = fopen(bmp_path, "wb");
+	fwrite(bmp, 1, sizeof(bmp), file);
+	fclose(file);
+
+	for (const char* path : {ppm_path, bmp_path}) {
+		auto rows = row_decoder::open(path);
+		ASSERT(rows && rows->width() == 2 && rows->height() == 2)
+
+		uint8_t rgba[4];
+		rows->decode(1, 1, 1, rgba);
+		ASSERT(rgba[0] == 10 && rgba[1] == 11 && rgba[2] == 12 && rgba[3] == 255)
+
+		rows->decode(0, 0, 1, rgba);
+		ASSERT(rgba[0] == 1 && rgba[1] == 2 && rgba[2] == 3)
+	}
+
+	// truncated files are left to the regular decoder
+	file = fopen(ppm_path, "wb");
+	fwrite(header, 1, sizeof(header) - 1, file);
+	fclose(file);
+
+	ASSERT(!row_decoder::open(ppm_path))
+
+	// numbers too long to be a size aren't split into the next field, and heights that can't be negated are rejected
+	const char split[] = "P6\n1 1000000255\n";
+	file = fopen(ppm_path, "wb");
+	fwrite(split, 1, sizeof(split) - 1, file);
+	fclose(file);
+
+	ASSERT(!row_decoder::open(ppm_path))
+
+	bmp[22] = bmp[23] = bmp[24] = 0;
+	bmp[25] = 0x80;
+	file = fopen(bmp_path, "wb");
+	fwrite(bmp, 1, sizeof(bmp), file);
+	fclose(file);
+
+	ASSERT(!row_decoder::open(bmp_path))
+
+	remove(ppm_path);
+	remove(bmp_path);
+}
+
+static void test_frame_queue() {
+
+	frame_queue queue{2, 3, 2, 4};
+	ASSERT(queue.pitch() == 12)
+
+	// the producer gets ahead by at most the capacity, and frames arrive in order
+	std::thread producer{[&] {
+		for (int i = 0; i < 100; i++) {
+			queued_frame* slot = queue.acquire();
+			slot->frame = i;
+			slot->pixels[0] = i;
+			queue.publish();
+		}
+
+		queue.close();
+	}};
+
+	for (int i = 0; i < 100; i++) {
+		const queued_frame* next = queue.front();
+		ASSERT(next && next->frame == i && next->pixels[0] == i)
+		queue.release();
+	}
+
+	ASSERT(queue.front() == nullptr)
+	producer.join();
+
+	// closing from the consumer side stops a producer waiting for a free slot
+	frame_queue full{1, 1, 1, 4};
+	full.acquire();
+	full.publish();
+
+	std::thread blocked{[&] { ASSERT(full.acquire() == nullptr) }};
+	full.close();
+	blocked.join();
+}
+
+static void test_queued_threads() {
+
+	// large enough to be split between threads, both when converted and when presented from the shadow copy
+	const int w = 512, h = 512, frames = 3;
+	std::vector<uint8_t> rgba(size_t(w) * h * 4 * frames);
+
+	for (size_t i = 0; i < rgba.size(); i += 4) {
+		const size_t pixel = i / 4;
+		rgba[i] = pixel / (size_t(w) * h) * 80;
+		rgba[i + 1] = pixel % 251;
+		rgba[i + 2] = pixel / w % 253;
+		rgba[i + 3] = 255;
+	}
+
+	image anim{rgba.data(), w, h};
+	anim.frames = frames;
+	anim.mspt = 1'000;
+	anim.loops = 2;
+
+	memory_screen expected{w, h, memory_screen::named_format("xrgb8888")};
+	memory_screen actual{w, h, memory_screen::named_format("xrgb8888")};
+
+	actual.set_threads(4);
+	actual.set_shadow(true);
+
+	expected.blit(anim);
+	actual.blit(anim);
+	ASSERT(memcmp(expected.pixels(), actual.pixels(), size_t(w) * h * 4) == 0)
+}
+
+// Memory screen that records what is written into it
+class recording_screen : public memory_screen {
+
+protected:
+
+	void invalidate(constraint region) override {
+		written.push_back(region);
+	}
+
+public:
+
+	std::vector<constraint> written;
+	mutable int flushes = 0;
+
+	recording_screen(int width, int height)
+		: memory_screen(width, height, memory_screen::named_format("xrgb8888")) {}
+
+	void flush() const override {
+		flushes++;
+	}
+};
+
+static void test_clear_flush() {
+
+	// a clear on its own is shown, without anything drawn after it
+	recording_screen screen{4, 4};
+	screen.clear({1, 2, 3, 255});
+	ASSERT(screen.flushes == 1 && screen.written.size() == 1)
+
+	// unless it's batched, then it's only shown with the rest
+	screen.begin_batch();
+	screen.clear({3, 2, 1, 255});
+	ASSERT(screen.flushes == 1)
+
+	screen.end_batch();
+	ASSERT(screen.flushes == 2)
+
+	// a translucent clear in a batch blends with the screen, like one outside of it
+	recording_screen direct{4, 4};
+	direct.clear({3, 2, 1, 255});
+	direct.clear({200, 100, 50, 128});
+
+	screen.begin_batch();
+	screen.clear({200, 100, 50, 128});
+	screen.end_batch();
+	ASSERT(memcmp(direct.pixels(), screen.pixels(), 4 * 4 * 4) == 0)
+}
+
+static void test_compositor_layers() {
+
+	// an opaque red square under half transparent blue one, and a separate green pixel
+	const uint8_t red_pixel[4] = {255, 0, 0, 255};
+	const uint8_t blue_pixel[4] = {0, 0, 255, 128};
+	uint8_t red[2 * 2 * 4], blue[2 * 2 * 4], green[4] = {0, 255, 0, 255};
+
+	for (int i = 0; i < 4; i++) {
+		memcpy(red + i * 4, red_pixel, 4);
+		memcpy(blue + i * 4, blue_pixel, 4);
+	}
+
+	image bottom{red, 2, 2};
+	image top{blue, 2, 2};
+	image apart{green, 1, 1};
+
+	top.ox = 1;
+	top.oy = 1;
+	top.blend = true;
+	apart.ox = 7;
+	apart.oy = 3;
+
+	recording_screen screen{8, 4};
+	screen.clear({0, 255, 0, 255});
+	screen.flushes = 0;
+	screen.written.clear();
+
+	compositor scene;
+	scene.add(top, 1);
+	scene.add(bottom);
+	scene.add(apart);
+	ASSERT(scene.size() == 3)
+
+	scene.compose(screen);
+
+	// one write for the two overlapping layers, one for the other, flushed once
+	ASSERT(screen.flushes == 1)
+	ASSERT(screen.written.size() == 2)
+	ASSERT(screen.written[0].min.x == 0 && screen.written[0].max.x == 3 && screen.written[0].max.y == 3)
+
+	// the blue layer is blended over the red one, the blend pixel order is B, G, R, X
+	const uint8_t* pixel = screen.pixels() + 1 * screen.line_length() + 1 * 4;
+	ASSERT(pixel[0] == 128 && pixel[2] == 127)
+
+	// where nothing is under it, the blue layer is blended with what the screen showed
+	pixel = screen.pixels() + 2 * screen.line_length() + 2 * 4;
+	ASSERT(pixel[0] == 128 && pixel[1] == 127 && pixel[2] == 0)
+
+	scene.remove(top);
+	ASSERT(scene.size() == 2)
+}
+
+static void test_arena_reuse() {
+
+	buffer_arena& arena = buffer_arena::shared();
+	arena.trim();
+
+	// small buffers come from the heap, but are still aligned
+	arena_buffer<color> small(10);
+	ASSERT(reinterpret_cast<uintptr_t>(small.data()) % ARENA_ALIGNMENT == 0)
+
+	const uint8_t* first;
+
+	{
+		arena_buffer<uint8_t> frame(3 * 1024 * 1024);
+		first = frame.data();
+
+		ASSERT(reinterpret_cast<uintptr_t>(first) % ARENA_ALIGNMENT == 0)
+		memset(frame.data(), 1, frame.size());
+	}
+
+	ASSERT(arena.kept() == 4 * 1024 * 1024)
+
+	// a buffer of a similar size reuses the released one, a much smaller one doesn't
+	arena_buffer<uint8_t> tiny(1024 * 1024);
+	ASSERT(tiny.data() != first)
+
+	arena_buffer<uint8_t> again(3 * 1024 * 1024 + 5);
+	ASSERT(again.data() == first && arena.kept() == 0)
+
+	arena_buffer<uint8_t> moved = std::move(again);
+	ASSERT(moved.data() == first && !again)
+}
+
+static void test_delta_frames() {
+
+	const int w = 6, h = 2;
+	std::vector<uint8_t> frames[3];
+
+	for (int i = 0; i < 3; i++) {
+		frames[i].assign(w * h * 4, 0);
+	}
+
+	// two pixels close together on the first row, then one on the second
+	frames[1][1 * 4] = 7;
+	frames[1][4 * 4 + 2] = 9;
+	frames[2] = frames[1];
+	frames[2][(w + 5) * 4 + 3] = 5;
+
+	delta_frames deltas{w, h, 3, 4};
+	constraint changed[3];
+
+	for (int i = 0; i < 3; i++) {
+		memcpy(deltas.scratch(), frames[i].data(), frames[i].size());
+		changed[i] = deltas.set_ready(i);
+		ASSERT(deltas.is_ready(0) == (i == 2))
+	}
+
+	ASSERT(changed[0].width() == w && changed[0].height() == h)
+	ASSERT(changed[1].min.x == 1 && changed[1].max.x == 5 && changed[1].height() == 1)
+	ASSERT(changed[2].min.x == 5 && changed[2].min.y == 1 && changed[2].width() == 1)
+	ASSERT(deltas.size() < 3 * frames[0].size())
+
+	// replaying from the last frame wraps around to the first one
+	std::vector<uint8_t> shown(deltas.latest(), deltas.latest() + w * h * 4);
+	deltas.release_latest();
+	ASSERT(deltas.latest() == nullptr)
+
+	for (int i = 0; i < 3; i++) {
+		deltas.apply(i, shown.data(), deltas.pitch());
+		ASSERT(shown == frames[i])
+	}
+
+	bool thrown = false;
+
+	try {
+		delta_frames unordered{w, h, 3, 4};
+		unordered.set_ready(1);
+	} catch (const std::runtime_error&) {
+		thrown = true;
+	}
+
+	ASSERT(thrown)
+}
+
 int main() {
 	test_framebuffer_channel();
 	test_framebuffer_format();
+	test_blitter_blend();
+	test_blitter_specialized();
+	test_viewport_union();
+	test_pool_run();
+	test_clock_deadline();
+	test_memory_screen_blit();
+	test_image_spans();
+	test_scale_rgba();
+	test_row_decoder();
+	test_frame_queue();
+	test_queued_threads();
+	test_clear_flush();
+	test_compositor_layers();
+	test_arena_reuse();
+	test_delta_frames();
 }
\ No newline at end of file